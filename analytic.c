@@ -0,0 +1,91 @@
+/* Purpose: Closed-form polling-system estimate of the bridge's utilisation
+ * and mean waits
+ */
+
+#include <math.h> // for INFINITY
+#include "analytic.h"
+
+void analytic_estimate(const scenario_t* sc, analytic_t* out) {
+  double a = (double) sc->cross_min / SIM_SEC;
+  double b = (double) sc->cross_max / SIM_SEC;
+  double c = sc->capacity;
+  double lambda[NUM_DIRECTIONS], rho_i[NUM_DIRECTIONS];
+  int i;
+
+  // moments of the crossing time X ~ U[a, b] and the service X / c
+  double ex = (a + b) / 2;
+  double ex2 = (a * a + a * b + b * b) / 3;
+  double eb = ex / c;
+  double eb2 = ex2 / (c * c);
+
+  double rho = 0, lambda_sum = 0;
+  for (i = 0; i < NUM_DIRECTIONS; i++) {
+    lambda[i] = sc->rate[i] / 60.0; // cars per second
+    rho_i[i] = lambda[i] * eb;
+    rho += rho_i[i];
+    lambda_sum += lambda[i];
+  }
+
+  // a switch-over costs the clearance time, plus the time the bridge runs
+  // below capacity while it empties: on average half a crossing with
+  // (c - 1) of its c places unused
+  double r = (double) sc->switch_time / SIM_SEC + ex * (c - 1) / (2 * c);
+  double r_total = NUM_DIRECTIONS * r; // deterministic, so E[R^2] = r_total^2
+
+  // with a batch limit k, a direction switches over at least every k of
+  // its cars, so it needs lambda_i * r_total / k of the bridge's time on
+  // top of its own traffic; k-limited polling is stable only while
+  // rho + lambda_i * r_total / k < 1 for every direction
+  double k = sc->batch_limit;
+  double limit[NUM_DIRECTIONS] = { 0, 0 };
+  out->utilisation = rho;
+  for (i = 0; i < NUM_DIRECTIONS && k > 0; i++) {
+    limit[i] = lambda[i] * r_total / k;
+    if (rho + limit[i] > out->utilisation)
+      out->utilisation = rho + limit[i];
+  }
+  out->stable = out->utilisation < 1;
+  out->capacity = 3600.0 / eb;
+  out->switch_over = r;
+  if (!out->stable) {
+    out->cycle = INFINITY;
+    out->wait[TO_HANOVER] = out->wait[TO_NORWICH] = out->mean_wait = INFINITY;
+    return;
+  }
+  out->cycle = r_total / (1 - rho);
+
+  // pseudo-conservation law for exhaustive service: sum of rho_i * W_i
+  double sum_rho2 = 0, sum_lb2 = 0;
+  for (i = 0; i < NUM_DIRECTIONS; i++) {
+    sum_rho2 += rho_i[i] * rho_i[i];
+    sum_lb2 += lambda[i] * eb2;
+  }
+  double pcl = rho * sum_lb2 / (2 * (1 - rho)) + rho * r_total / 2 +
+    r_total / (2 * (1 - rho)) * (rho * rho - sum_rho2);
+
+  double shape[NUM_DIRECTIONS], denom = 0;
+  if (k > 0) {
+    // the law for limited service, with each direction's switch-overs
+    // spread over k cars: sum of rho_i (1 - limit_i / (1 - rho)) W_i gains
+    // r_total / (2 (1 - rho)) * sum of rho_i^2 / k; Boxma-Meister then
+    // makes W_i proportional to (1 - rho + rho_i) / (1 - rho - limit_i),
+    // which turns the weights on the left into 1 / (1 - rho)
+    pcl += r_total / (2 * (1 - rho)) * sum_rho2 / k;
+    for (i = 0; i < NUM_DIRECTIONS; i++) {
+      shape[i] = (1 - rho + rho_i[i]) / (1 - rho - limit[i]);
+      denom += rho_i[i] * (1 - rho + rho_i[i]) / (1 - rho);
+    }
+  }
+  else {
+    // Boxma-Meister for exhaustive service: W_i proportional to (1 - rho_i)
+    for (i = 0; i < NUM_DIRECTIONS; i++) {
+      shape[i] = 1 - rho_i[i];
+      denom += rho_i[i] * (1 - rho_i[i]);
+    }
+  }
+  out->mean_wait = 0;
+  for (i = 0; i < NUM_DIRECTIONS; i++) {
+    out->wait[i] = denom > 0 ? shape[i] * pcl / denom : 0.0;
+    out->mean_wait += lambda_sum > 0 ? lambda[i] / lambda_sum * out->wait[i] : 0.0;
+  }
+}
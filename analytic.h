@@ -0,0 +1,51 @@
+/* Purpose: A closed-form estimate of the bridge's behaviour, to screen
+ * scenarios before paying for a full simulation.
+ *
+ * The bridge is treated as a two-queue polling system with exhaustive
+ * service: traffic keeps flowing one way until nobody is left to board,
+ * then switches over. With capacity c and crossing time X, a direction
+ * drains at up to c cars per E[X], so each car is a "service" of X/c.
+ * Each switch-over costs the clearance time plus the time the bridge runs
+ * below capacity while emptying. Mean waits come from the polling
+ * pseudo-conservation law split between directions in proportion to
+ * (1 - rho_i), the Boxma-Meister approximation for exhaustive service.
+ *
+ * With a batch limit of k cars, service is k-limited instead: a direction
+ * switches over at least every k cars, which costs it lambda_i * R / k of
+ * the bridge's time (R being both switch-overs). It is stable only while
+ * rho + lambda_i * R / k < 1 for both directions, and waits follow the
+ * limited-service pseudo-conservation law with the Boxma-Meister weights
+ * (1 - rho + rho_i) / (1 - rho - lambda_i * R / k).
+ */
+
+#ifndef ANALYTIC_H
+#define ANALYTIC_H
+
+#include "scenario.h"
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for the estimate of one scenario
+typedef struct analytic {
+  double utilisation;   // fraction of the bridge's capacity in use, rho,
+                        // plus the busier direction's forced switch-overs
+                        // under a batch limit
+  int stable;           // nonzero if queues stay finite (utilisation < 1)
+  double capacity;      // most cars per hour one direction can cross
+  double switch_over;   // time lost per switch-over, in seconds
+  double cycle;         // mean time between switches to the same direction
+  double wait[NUM_DIRECTIONS]; // mean wait towards each town, in seconds
+  double mean_wait;     // mean wait over all cars, in seconds
+} analytic_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Estimates a scenario's utilisation and mean waits in O(1)
+ *
+ * @param sc the scenario (incidents are ignored; the batch limit is
+ *           modelled as k-limited service)
+ * @param out where to save the estimate; waits are infinite if unstable
+ */
+void analytic_estimate(const scenario_t* sc, analytic_t* out);
+
+#endif // ANALYTIC_H
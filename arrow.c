@@ -0,0 +1,432 @@
+/* Purpose: Apache Arrow IPC files (Feather v2) with hand-built flatbuffer
+ * metadata
+ */
+
+#define _POSIX_C_SOURCE 200809L // for fileno()
+
+#include <stdio.h>
+#include <stdlib.h> // for malloc()
+#include <string.h> // for strcmp()
+#include <fcntl.h>  // for open()
+#include <unistd.h> // for close()
+#include "arrow.h"
+
+#define ARROW_MAGIC "ARROW1\0\0" // the file's first 8 bytes; its last 6 are
+#define ARROW_MAGIC_LEN 6        // the same without the padding
+#define CONTINUATION 0xFFFFFFFFu // starts every message
+#define METADATA_V5 4            // MetadataVersion the metadata follows
+#define BODY_ALIGN 64            // alignment of every body buffer
+
+// flatbuffer union tags
+#define HEADER_SCHEMA 1
+#define HEADER_RECORD_BATCH 3
+#define TYPE_INT 2
+#define TYPE_FLOATING_POINT 3
+#define TYPE_DURATION 18
+
+#define PRECISION_DOUBLE 2
+#define UNIT_MICROSECOND 2
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for a flatbuffer being built
+//
+// Flatbuffers are usually built back to front; this one is built front to
+// back, every table preceded by its vtable and followed by its children,
+// because offsets to children are unsigned and so must point forwards
+typedef struct fb {
+  unsigned char* buf;
+  size_t len;           // bytes built so far
+  size_t cap;           // size of buf
+  int failed;           // nonzero once an allocation has failed
+} fb_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Appends n zero bytes to a flatbuffer
+ *
+ * @return where they start
+ */
+static size_t fb_reserve(fb_t* fb, size_t n) {
+  size_t pos = fb->len;
+  if (fb->failed)
+    return 0;
+  if (pos + n > fb->cap) {
+    size_t cap = fb->cap ? fb->cap : 1024;
+    while (cap < pos + n)
+      cap *= 2;
+    unsigned char* buf = (unsigned char*) realloc(fb->buf, cap);
+    if (buf == NULL) {
+      fb->failed = 1;
+      return 0;
+    }
+    fb->buf = buf;
+    fb->cap = cap;
+  }
+  memset(fb->buf + pos, 0, n);
+  fb->len += n;
+  return pos;
+}
+
+/* Pads a flatbuffer with zeros until its length plus skew is a multiple
+ * of align
+ */
+static void fb_pad(fb_t* fb, size_t align, size_t skew) {
+  size_t extra = (align - (fb->len + skew) % align) % align;
+  if (extra)
+    fb_reserve(fb, extra);
+}
+
+/* Stores a little-endian integer of 1, 2, 4 or 8 bytes at pos */
+static void fb_put(fb_t* fb, size_t pos, uint64_t v, int bytes) {
+  int i;
+  if (fb->failed)
+    return;
+  for (i = 0; i < bytes; i++)
+    fb->buf[pos + i] = (unsigned char) (v >> (8 * i));
+}
+
+/* Points the offset field at pos to the object at target */
+static void fb_link(fb_t* fb, size_t pos, size_t target) {
+  fb_put(fb, pos, target - pos, 4);
+}
+
+/* Appends a table and its vtable, with every field zeroed
+ *
+ * @param n the number of fields in the vtable
+ * @param sizes the bytes of each field, 0 for one left out (so it reads
+ *              as its default)
+ * @param fields where to save the position of each field
+ * @return the table's position
+ */
+static size_t fb_table(fb_t* fb, int n, const int* sizes, size_t* fields) {
+  size_t offsets[16], size = 4; // fields follow the offset to the vtable
+  int i, align = 4;
+
+  for (i = 0; i < n; i++) {
+    if (sizes[i] == 0)
+      continue;
+    size = (size + sizes[i] - 1) / sizes[i] * sizes[i];
+    offsets[i] = size;
+    size += sizes[i];
+    if (sizes[i] > align)
+      align = sizes[i];
+  }
+
+  fb_pad(fb, 2, 0);
+  size_t vtable = fb_reserve(fb, 4 + 2 * n);
+  fb_put(fb, vtable, 4 + 2 * n, 2);
+  fb_put(fb, vtable + 2, size, 2);
+  for (i = 0; i < n; i++)
+    fb_put(fb, vtable + 4 + 2 * i, sizes[i] ? offsets[i] : 0, 2);
+
+  fb_pad(fb, align, 0);
+  size_t table = fb_reserve(fb, size);
+  fb_put(fb, table, table - vtable, 4); // the vtable lies before the table
+  for (i = 0; i < n; i++)
+    fields[i] = table + offsets[i];
+  return table;
+}
+
+/* Appends a vector with room for count elements, which start aligned to
+ * their size (up to 8 bytes)
+ *
+ * @return the vector's position; its elements start 4 bytes later
+ */
+static size_t fb_vector(fb_t* fb, int count, int elem_size) {
+  fb_pad(fb, elem_size >= 8 ? 8 : 4, 4);
+  size_t vec = fb_reserve(fb, 4 + (size_t) count * elem_size);
+  fb_put(fb, vec, count, 4);
+  return vec;
+}
+
+/* Appends a NUL-terminated string
+ *
+ * @return the string's position
+ */
+static size_t fb_string(fb_t* fb, const char* s) {
+  size_t n = strlen(s);
+  fb_pad(fb, 4, 0);
+  size_t str = fb_reserve(fb, 4 + n + 1);
+  fb_put(fb, str, n, 4);
+  if (!fb->failed)
+    memcpy(fb->buf + str + 4, s, n);
+  return str;
+}
+
+/* Appends a Field table describing one column
+ *
+ * @return the table's position
+ */
+static size_t put_field(fb_t* fb, const arrow_column_t* col) {
+  // name, nullable, type_type, type, dictionary (none), children
+  static const int field_sizes[] = { 4, 1, 1, 4, 0, 4 };
+  static const int int_sizes[] = { 4, 1 }; // bitWidth, is_signed
+  static const int unit_sizes[] = { 2 };   // precision or unit
+  size_t f[6], t[2];
+
+  size_t field = fb_table(fb, 6, field_sizes, f);
+  fb_link(fb, f[0], fb_string(fb, col->name));
+  switch (col->type) {
+  case ARROW_DOUBLE:
+    fb_put(fb, f[2], TYPE_FLOATING_POINT, 1);
+    fb_link(fb, f[3], fb_table(fb, 1, unit_sizes, t));
+    fb_put(fb, t[0], PRECISION_DOUBLE, 2);
+    break;
+  case ARROW_DURATION_US:
+    fb_put(fb, f[2], TYPE_DURATION, 1);
+    fb_link(fb, f[3], fb_table(fb, 1, unit_sizes, t));
+    fb_put(fb, t[0], UNIT_MICROSECOND, 2);
+    break;
+  default:
+    fb_put(fb, f[2], TYPE_INT, 1);
+    fb_link(fb, f[3], fb_table(fb, 2, int_sizes, t));
+    fb_put(fb, t[0], 8 * arrow_width(col->type), 4);
+    fb_put(fb, t[1], col->type != ARROW_UINT64, 1);
+    break;
+  }
+  fb_link(fb, f[5], fb_vector(fb, 0, 4));
+  return field;
+}
+
+/* Appends a Schema table of a writer's columns (little-endian)
+ *
+ * @return the table's position
+ */
+static size_t put_schema(fb_t* fb, const arrow_writer_t* aw) {
+  static const int schema_sizes[] = { 0, 4 }; // endianness, fields
+  size_t f[2];
+  int i;
+
+  size_t schema = fb_table(fb, 2, schema_sizes, f);
+  size_t vec = fb_vector(fb, aw->num_cols, 4);
+  fb_link(fb, f[1], vec);
+  for (i = 0; i < aw->num_cols; i++)
+    fb_link(fb, vec + 4 + 4 * i, put_field(fb, &aw->cols[i]));
+  return schema;
+}
+
+/* Starts a Message flatbuffer: its root offset and Message table
+ *
+ * @return the position of the header field, to link the header to
+ */
+static size_t put_message(fb_t* fb, int header_type, int64_t body_len) {
+  // version, header_type, header, bodyLength
+  static const int message_sizes[] = { 2, 1, 4, 8 };
+  size_t f[4];
+
+  fb->len = 0;
+  size_t root = fb_reserve(fb, 4);
+  fb_link(fb, root, fb_table(fb, 4, message_sizes, f));
+  fb_put(fb, f[0], METADATA_V5, 2);
+  fb_put(fb, f[1], header_type, 1);
+  fb_put(fb, f[3], (uint64_t) body_len, 8);
+  return f[2];
+}
+
+/* Appends bytes to the file */
+static void put_bytes(arrow_writer_t* aw, const void* p, size_t n) {
+  outbuf_put(&aw->out, (const char*) p, n);
+  aw->offset += n;
+}
+
+/* Appends zeros to the file until its length is a multiple of align */
+static void put_padding(arrow_writer_t* aw, int align) {
+  static const char zeros[BODY_ALIGN];
+  put_bytes(aw, zeros, (align - aw->offset % align) % align);
+}
+
+/* Appends a little-endian 32-bit integer to the file */
+static void put_int32(arrow_writer_t* aw, uint32_t v) {
+  unsigned char b[4] = { v, v >> 8, v >> 16, v >> 24 };
+  put_bytes(aw, b, 4);
+}
+
+/* Writes a message's prefix and metadata, padded so that its body starts
+ * BODY_ALIGN-aligned in the file
+ *
+ * @return the bytes of prefix and metadata
+ */
+static int32_t put_metadata(arrow_writer_t* aw, fb_t* fb) {
+  int64_t start = aw->offset;
+  size_t pad = (BODY_ALIGN - (start + 8 + fb->len) % BODY_ALIGN) % BODY_ALIGN;
+  put_int32(aw, CONTINUATION);
+  put_int32(aw, (uint32_t) (fb->len + pad));
+  put_bytes(aw, fb->buf, fb->len);
+  put_padding(aw, BODY_ALIGN);
+  return (int32_t) (aw->offset - start);
+}
+
+/* Doubles the room for record batch blocks
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int grow_blocks(arrow_writer_t* aw) {
+  int max_blocks = aw->max_blocks ? 2 * aw->max_blocks : 16;
+  arrow_block_t* blocks = (arrow_block_t*) realloc(aw->blocks, max_blocks * sizeof(arrow_block_t));
+  if (blocks == NULL)
+    return -1;
+  aw->blocks = blocks;
+  aw->max_blocks = max_blocks;
+  return 0;
+}
+
+/* Writes the staged rows as one record batch
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int write_batch(arrow_writer_t* aw) {
+  static const int batch_sizes[] = { 8, 4, 4 }; // length, nodes, buffers
+  fb_t fb = { NULL, 0, 0, 0 };
+  int64_t body_len = 0, offset = 0;
+  size_t f[3];
+  int c;
+
+  for (c = 0; c < aw->num_cols; c++)
+    body_len += (aw->rows * arrow_width(aw->cols[c].type) + BODY_ALIGN - 1) / BODY_ALIGN * BODY_ALIGN;
+
+  size_t header = put_message(&fb, HEADER_RECORD_BATCH, body_len);
+  fb_link(&fb, header, fb_table(&fb, 3, batch_sizes, f));
+  fb_put(&fb, f[0], (uint64_t) aw->rows, 8);
+  size_t nodes = fb_vector(&fb, aw->num_cols, 16); // FieldNode: length, null_count
+  fb_link(&fb, f[1], nodes);
+  for (c = 0; c < aw->num_cols; c++)
+    fb_put(&fb, nodes + 4 + 16 * c, (uint64_t) aw->rows, 8);
+  // Buffer: offset, length; a column's validity buffer is left empty
+  // since no value is null, then comes its data
+  size_t buffers = fb_vector(&fb, 2 * aw->num_cols, 16);
+  fb_link(&fb, f[2], buffers);
+  for (c = 0; c < aw->num_cols; c++) {
+    int64_t len = aw->rows * arrow_width(aw->cols[c].type);
+    fb_put(&fb, buffers + 4 + 32 * c, (uint64_t) offset, 8);
+    fb_put(&fb, buffers + 4 + 32 * c + 16, (uint64_t) offset, 8);
+    fb_put(&fb, buffers + 4 + 32 * c + 24, (uint64_t) len, 8);
+    offset += (len + BODY_ALIGN - 1) / BODY_ALIGN * BODY_ALIGN;
+  }
+
+  if (fb.failed || (aw->num_blocks == aw->max_blocks && grow_blocks(aw))) {
+    fprintf(stderr, "Error allocating Arrow record batch metadata\n");
+    free(fb.buf);
+    return -1;
+  }
+  arrow_block_t* block = &aw->blocks[aw->num_blocks++];
+  block->offset = aw->offset;
+  block->meta_len = put_metadata(aw, &fb);
+  block->body_len = body_len;
+  for (c = 0; c < aw->num_cols; c++) {
+    put_bytes(aw, aw->data[c], aw->rows * arrow_width(aw->cols[c].type));
+    put_padding(aw, BODY_ALIGN);
+  }
+  aw->rows = 0;
+  free(fb.buf);
+  return 0;
+}
+
+/* Writes the end-of-stream marker and the footer, which repeats the
+ * schema and locates every record batch
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int write_footer(arrow_writer_t* aw) {
+  // version, schema, dictionaries, recordBatches
+  static const int footer_sizes[] = { 2, 4, 4, 4 };
+  fb_t fb = { NULL, 0, 0, 0 };
+  size_t f[4];
+  int i;
+
+  put_int32(aw, CONTINUATION);
+  put_int32(aw, 0);
+
+  size_t root = fb_reserve(&fb, 4);
+  fb_link(&fb, root, fb_table(&fb, 4, footer_sizes, f));
+  fb_put(&fb, f[0], METADATA_V5, 2);
+  fb_link(&fb, f[1], put_schema(&fb, aw));
+  fb_link(&fb, f[2], fb_vector(&fb, 0, 24));
+  size_t blocks = fb_vector(&fb, aw->num_blocks, 24); // Block: offset, metaDataLength, bodyLength
+  fb_link(&fb, f[3], blocks);
+  for (i = 0; i < aw->num_blocks; i++) {
+    fb_put(&fb, blocks + 4 + 24 * i, (uint64_t) aw->blocks[i].offset, 8);
+    fb_put(&fb, blocks + 4 + 24 * i + 8, (uint32_t) aw->blocks[i].meta_len, 4);
+    fb_put(&fb, blocks + 4 + 24 * i + 16, (uint64_t) aw->blocks[i].body_len, 8);
+  }
+  if (fb.failed) {
+    fprintf(stderr, "Error allocating Arrow footer\n");
+    free(fb.buf);
+    return -1;
+  }
+
+  put_bytes(aw, fb.buf, fb.len);
+  put_int32(aw, (uint32_t) fb.len);
+  put_bytes(aw, ARROW_MAGIC, ARROW_MAGIC_LEN);
+  free(fb.buf);
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int arrow_open(arrow_writer_t* aw, const char* path, const arrow_column_t* cols, int num_cols) {
+  fb_t fb = { NULL, 0, 0, 0 };
+  int c;
+
+  memset(aw, 0, sizeof(*aw));
+  if (num_cols > ARROW_MAX_COLUMNS) {
+    fprintf(stderr, "Error, Arrow tables have at most %d columns\n", ARROW_MAX_COLUMNS);
+    return -1;
+  }
+  int fd = strcmp(path, "-") == 0 ? fileno(stdout) : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("Error creating Arrow file");
+    return -1;
+  }
+  if (outbuf_init(&aw->out, fd, 0)) {
+    if (fd != fileno(stdout))
+      close(fd);
+    return -1;
+  }
+  aw->out.line_flush = 0; // tables are data; never flush per row
+  aw->cols = cols;
+  aw->num_cols = num_cols;
+  for (c = 0; c < num_cols; c++) {
+    if ((aw->data[c] = (unsigned char*) malloc(ARROW_BATCH_ROWS * arrow_width(cols[c].type))) == NULL) {
+      fprintf(stderr, "Error allocating Arrow column '%s'\n", cols[c].name);
+      aw->error = 1;
+    }
+  }
+
+  put_bytes(aw, ARROW_MAGIC, sizeof(ARROW_MAGIC) - 1);
+  fb_link(&fb, put_message(&fb, HEADER_SCHEMA, 0), put_schema(&fb, aw));
+  if (fb.failed) {
+    fprintf(stderr, "Error allocating Arrow schema\n");
+    aw->error = 1;
+  }
+  else
+    put_metadata(aw, &fb);
+  free(fb.buf);
+  if (aw->error) {
+    arrow_close(aw);
+    return -1;
+  }
+  return 0;
+}
+
+int arrow_end_row(arrow_writer_t* aw) {
+  if (++aw->rows == ARROW_BATCH_ROWS && write_batch(aw))
+    aw->error = 1;
+  return aw->error || aw->out.error ? -1 : 0;
+}
+
+int arrow_close(arrow_writer_t* aw) {
+  int c, fd = aw->out.fd;
+
+  if (!aw->error && ((aw->rows > 0 && write_batch(aw)) || write_footer(aw)))
+    aw->error = 1;
+  int rc = outbuf_destroy(&aw->out) || aw->error ? -1 : 0;
+  if (fd != fileno(stdout) && close(fd))
+    rc = -1;
+  for (c = 0; c < aw->num_cols; c++)
+    free(aw->data[c]);
+  free(aw->blocks);
+  if (rc)
+    fprintf(stderr, "Error writing Arrow file\n");
+  return rc;
+}
@@ -0,0 +1,126 @@
+/* Purpose: Tables written as Apache Arrow IPC files (Feather v2), so that
+ * analysis tools map large run outputs straight into columns instead of
+ * parsing text.
+ *
+ * A file holds one schema and any number of record batches:
+ *
+ *   file    := "ARROW1\0\0" message(schema) message(batch)* eos footer
+ *              int32(footer bytes) "ARROW1"
+ *   message := 0xFFFFFFFF int32(metadata bytes) metadata body
+ *   eos     := 0xFFFFFFFF 0x00000000
+ *
+ * Metadata and the footer are flatbuffers, built here by hand since the
+ * few tables Arrow needs do not justify a dependency. A body is each
+ * column's values in one contiguous buffer, 64-byte aligned, so a reader
+ * that maps the file uses them in place. Columns are fixed-width and
+ * never null, and values are written in the machine's byte order, which
+ * Arrow requires to be little-endian.
+ *
+ * Rows are staged column by column and a batch is written every
+ * ARROW_BATCH_ROWS rows, so memory stays bounded however long the table.
+ */
+
+#ifndef ARROW_H
+#define ARROW_H
+
+#include <stdint.h>
+#include "outbuf.h"
+
+// column types
+#define ARROW_INT8 0
+#define ARROW_INT32 1
+#define ARROW_INT64 2
+#define ARROW_UINT64 3
+#define ARROW_DOUBLE 4
+#define ARROW_DURATION_US 5 // int64 microseconds, such as a sim_time_t
+
+#define ARROW_MAX_COLUMNS 32
+#define ARROW_BATCH_ROWS (64 * 1024) // rows staged before a batch is written
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for a column of a table's schema
+typedef struct arrow_column {
+  const char* name; // the column's name
+  int type;         // one of the column types above
+} arrow_column_t;
+
+// define a data structure for where a record batch lies in the file
+typedef struct arrow_block {
+  int64_t offset;   // where its message starts
+  int32_t meta_len; // bytes of its prefix and metadata
+  int64_t body_len; // bytes of its body
+} arrow_block_t;
+
+// define a data structure for a table being written
+typedef struct arrow_writer {
+  outbuf_t out;          // buffered file output
+  int64_t offset;        // bytes written to the file so far
+  const arrow_column_t* cols; // the schema
+  int num_cols;
+  unsigned char* data[ARROW_MAX_COLUMNS]; // staged values of each column
+  int64_t rows;          // rows staged
+  arrow_block_t* blocks; // record batches written, for the footer
+  int num_blocks;
+  int max_blocks;        // allocated blocks
+  int error;             // nonzero once anything has failed
+} arrow_writer_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Returns the bytes one value of a column type takes */
+static inline int arrow_width(int type) {
+  return type == ARROW_INT8 ? 1 : type == ARROW_INT32 ? 4 : 8;
+}
+
+/* Sets an integer column (of any integer or duration type) in the row
+ * being staged
+ *
+ * @param aw the table
+ * @param col the column's index in the schema
+ * @param v the value
+ */
+static inline void arrow_set_int(arrow_writer_t* aw, int col, int64_t v) {
+  unsigned char* p = aw->data[col];
+  switch (aw->cols[col].type) {
+  case ARROW_INT8:
+    ((int8_t*) p)[aw->rows] = (int8_t) v;
+    break;
+  case ARROW_INT32:
+    ((int32_t*) p)[aw->rows] = (int32_t) v;
+    break;
+  default:
+    ((int64_t*) p)[aw->rows] = v;
+    break;
+  }
+}
+
+/* Sets a double column in the row being staged */
+static inline void arrow_set_double(arrow_writer_t* aw, int col, double v) {
+  ((double*) aw->data[col])[aw->rows] = v;
+}
+
+/* Creates an Arrow file and writes its schema
+ *
+ * @param aw the writer to initialize
+ * @param path the file to create ("-" for stdout)
+ * @param cols the columns, which must outlive the writer
+ * @param num_cols the number of columns, at most ARROW_MAX_COLUMNS
+ * @return 0 on success, -1 on error
+ */
+int arrow_open(arrow_writer_t* aw, const char* path, const arrow_column_t* cols, int num_cols);
+
+/* Finishes the row being staged, once every column is set; writes a
+ * record batch when ARROW_BATCH_ROWS rows are staged
+ *
+ * @return 0 on success, -1 on write or allocation error
+ */
+int arrow_end_row(arrow_writer_t* aw);
+
+/* Writes the staged rows and the footer, and closes the file
+ *
+ * @return 0 on success, -1 if anything failed since arrow_open()
+ */
+int arrow_close(arrow_writer_t* aw);
+
+#endif // ARROW_H
@@ -0,0 +1,261 @@
+/* Purpose: Compares two benchmark result files written by
+ * "ledyard --mode bench", such as before and after a locking change.
+ *
+ * Runs are matched by scenario and metric. For every metric the tool
+ * reports the relative change of the mean with a 95% confidence interval
+ * (Welch's t-test, which does not assume equal variances), and calls the
+ * change significant only when the interval excludes zero. Metrics whose
+ * runs vary by more than the noise threshold (coefficient of variation)
+ * are flagged as noisy instead, since a confident verdict from them would
+ * mostly reflect the machine's load.
+ *
+ * Usage: benchcmp [--noise 0.05] BEFORE AFTER
+ * Exits with 1 if any metric got significantly worse.
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for strtod(), realloc()
+#include <string.h> // for strcmp()
+#include <math.h>   // for sqrt()
+#include "steady.h" // for student_t975()
+
+#define NAME_LEN 64
+#define LINE_LEN 1024
+#define BEFORE 0
+#define AFTER 1
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one metric of one scenario in both files
+typedef struct series {
+  char scenario[NAME_LEN];
+  char metric[NAME_LEN];
+  double* values[2];    // the runs' values in each file
+  int n[2];             // the number of runs in each file
+  int cap[2];           // allocated room in values
+} series_t;
+
+// define a data structure for every series read so far, in input order
+typedef struct table {
+  series_t* series;
+  int n;
+  int cap;
+} table_t;
+
+// define a data structure for the summary of one side of a series
+typedef struct summary {
+  double mean;
+  double var;  // sample variance
+  double cv;   // coefficient of variation
+} summary_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Returns the series for a scenario and metric, adding it if new
+ *
+ * @return the series, or NULL on allocation error
+ */
+static series_t* find_series(table_t* t, const char* scenario, const char* metric) {
+  int i;
+  for (i = 0; i < t->n; i++) {
+    if (strcmp(t->series[i].scenario, scenario) == 0 && strcmp(t->series[i].metric, metric) == 0)
+      return &t->series[i];
+  }
+  if (t->n == t->cap) {
+    int cap = t->cap ? 2 * t->cap : 32;
+    series_t* grown = (series_t*) realloc(t->series, cap * sizeof(series_t));
+    if (grown == NULL)
+      return NULL;
+    t->series = grown;
+    t->cap = cap;
+  }
+  series_t* s = &t->series[t->n++];
+  memset(s, 0, sizeof(*s));
+  snprintf(s->scenario, sizeof(s->scenario), "%s", scenario);
+  snprintf(s->metric, sizeof(s->metric), "%s", metric);
+  return s;
+}
+
+/* Appends one run's value to a side of a series
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int add_value(series_t* s, int side, double value) {
+  if (s->n[side] == s->cap[side]) {
+    int cap = s->cap[side] ? 2 * s->cap[side] : 16;
+    double* grown = (double*) realloc(s->values[side], cap * sizeof(double));
+    if (grown == NULL)
+      return -1;
+    s->values[side] = grown;
+    s->cap[side] = cap;
+  }
+  s->values[side][s->n[side]++] = value;
+  return 0;
+}
+
+/* Reads every "bench" line of a result file into one side of the table
+ *
+ * @param t the table
+ * @param path the result file
+ * @param side BEFORE or AFTER
+ * @return 0 on success, -1 on error
+ */
+static int read_results(table_t* t, const char* path, int side) {
+  char line[LINE_LEN];
+  int lineno = 0;
+
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening benchmark results '%s'\n", path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char scenario[NAME_LEN] = "";
+    char* tok;
+    lineno++;
+    if (strncmp(line, "bench ", 6) != 0)
+      continue; // comments and anything else the run printed
+
+    // the scenario comes first; every other numeric field is a metric
+    for (tok = strtok(line + 6, " \t\n"); tok != NULL; tok = strtok(NULL, " \t\n")) {
+      char* eq = strchr(tok, '=');
+      char* end;
+      if (eq == NULL)
+	continue;
+      *eq = '\0';
+      if (strcmp(tok, "scenario") == 0) {
+	snprintf(scenario, sizeof(scenario), "%s", eq + 1);
+	continue;
+      }
+      if (strcmp(tok, "run") == 0 || scenario[0] == '\0')
+	continue;
+      double value = strtod(eq + 1, &end);
+      if (end == eq + 1 || *end != '\0')
+	continue;
+      series_t* s = find_series(t, scenario, tok);
+      if (s == NULL || add_value(s, side, value)) {
+	fprintf(stderr, "Error storing benchmark results from '%s' line %d\n", path, lineno);
+	fclose(fp);
+	return -1;
+      }
+    }
+  }
+  fclose(fp);
+  return 0;
+}
+
+/* Summarizes one side of a series */
+static summary_t summarize(const double* v, int n) {
+  summary_t s = { 0, 0, 0 };
+  int i;
+  for (i = 0; i < n; i++)
+    s.mean += v[i];
+  s.mean /= n;
+  for (i = 0; i < n; i++)
+    s.var += (v[i] - s.mean) * (v[i] - s.mean);
+  s.var = n > 1 ? s.var / (n - 1) : 0.0;
+  s.cv = s.mean != 0 ? sqrt(s.var) / fabs(s.mean) : 0.0;
+  return s;
+}
+
+/* Returns +1 if a metric is better when higher (throughputs), -1 if
+ * better when lower (times), and 0 if neither (simulated results, which
+ * should not change at all)
+ */
+static int metric_direction(const char* metric) {
+  size_t len = strlen(metric);
+  if (len > 8 && strcmp(metric + len - 8, "_per_sec") == 0)
+    return 1;
+  if (len > 3 && strcmp(metric + len - 3, "_us") == 0)
+    return -1;
+  return 0;
+}
+
+/************************* MAIN ****************************/
+
+/* Compares two benchmark result files
+ *
+ * @param argc the number of arguments
+ * @param argv [--noise CV] BEFORE AFTER
+ * @return 0 if no metric got significantly worse, 1 if one did, 2 on error
+ *         or when no metric could be compared
+ */
+int main(int argc, char* argv[]) {
+  table_t t = { NULL, 0, 0 };
+  double noise = 0.05;
+  int i, arg = 1, worse = 0, compared = 0;
+
+  if (argc == 5 && strcmp(argv[1], "--noise") == 0) {
+    noise = strtod(argv[2], NULL);
+    arg = 3;
+  }
+  if (argc - arg != 2 || noise <= 0) {
+    fprintf(stderr, "Usage: %s [--noise CV] BEFORE AFTER\n", argv[0]);
+    return 2;
+  }
+  if (read_results(&t, argv[arg], BEFORE) || read_results(&t, argv[arg + 1], AFTER))
+    return 2;
+
+  printf("%-16s %-14s %12s %12s %8s %20s  %s\n", "scenario", "metric", "before", "after",
+	 "change", "95% CI", "verdict");
+  for (i = 0; i < t.n; i++) {
+    series_t* s = &t.series[i];
+    if (s->n[BEFORE] == 0 || s->n[AFTER] == 0) {
+      printf("%-16s %-14s only in the %s results\n", s->scenario, s->metric,
+	     s->n[BEFORE] ? "before" : "after");
+      continue;
+    }
+    summary_t a = summarize(s->values[BEFORE], s->n[BEFORE]);
+    summary_t b = summarize(s->values[AFTER], s->n[AFTER]);
+
+    // Welch's t interval for the difference of means, with
+    // Welch-Satterthwaite degrees of freedom
+    double va = a.var / s->n[BEFORE], vb = b.var / s->n[AFTER];
+    double se = sqrt(va + vb);
+    double diff = b.mean - a.mean;
+    double half = 0;
+    if (se > 0) {
+      double df = (va + vb) * (va + vb) /
+	((s->n[BEFORE] > 1 ? va * va / (s->n[BEFORE] - 1) : 0) +
+	 (s->n[AFTER] > 1 ? vb * vb / (s->n[AFTER] - 1) : 0));
+      half = student_t975(df >= 1 ? (int) df : 1) * se;
+    }
+    double scale = a.mean != 0 ? 100 / fabs(a.mean) : 0;
+
+    const char* verdict;
+    int dir = metric_direction(s->metric);
+    if (s->n[BEFORE] < 2 || s->n[AFTER] < 2)
+      verdict = "too few runs";
+    else if (a.cv > noise || b.cv > noise)
+      verdict = "noisy";
+    else if (diff - half <= 0 && diff + half >= 0)
+      verdict = "no change";
+    else if (dir == 0)
+      verdict = "CHANGED";
+    else if ((diff > 0) == (dir > 0))
+      verdict = "better";
+    else {
+      verdict = "WORSE";
+      worse++;
+    }
+    compared++;
+
+    char ci[32];
+    snprintf(ci, sizeof(ci), "[%+.1f%%, %+.1f%%]", (diff - half) * scale, (diff + half) * scale);
+    printf("%-16s %-14s %12.4g %12.4g %+7.1f%% %20s  %s\n", s->scenario, s->metric,
+	   a.mean, b.mean, diff * scale, ci, verdict);
+  }
+  printf("%d metric(s) compared, %d significantly worse (noise threshold %.0f%%)\n",
+	 compared, worse, noise * 100);
+
+  for (i = 0; i < t.n; i++) {
+    free(t.series[i].values[BEFORE]);
+    free(t.series[i].values[AFTER]);
+  }
+  free(t.series);
+  if (compared == 0) {
+    fprintf(stderr, "Error, no metric is in both the before and after results\n");
+    return 2;
+  }
+  return worse ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/* Purpose: Checks of the invariants behind the simulation's statistics
+ * and screens that a golden trace cannot see, since they change printed
+ * results rather than the order of events. "make test" runs them after
+ * the golden scenarios.
+ *
+ * Usage: check
+ * Exits with 1 if any check failed.
+ */
+
+#include <stdio.h>
+#include <math.h>   // for fabs()
+#include "steady.h"
+#include "analytic.h"
+
+// fails the current check, saying where and why, unless cond holds
+#define CHECK(cond, ...)						\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);		\
+      fprintf(stderr, __VA_ARGS__);					\
+      fprintf(stderr, "\n");						\
+      return -1;							\
+    }									\
+  } while (0)
+
+/*************************** CHECKS **************************/
+
+/* Pushes observations 0, 1, 2, ... through enough merges that the store
+ * fills several times, checking that every stored batch mean covers the
+ * same number of consecutive observations
+ *
+ * @return 0 if the check passed, -1 otherwise
+ */
+static int check_steady_batches(void) {
+  static steady_t st; // too large for the stack of some threads
+  int merges, j;
+
+  for (merges = 0; merges <= 3; merges++) {
+    long k = (long) MSER_BATCH << merges;
+    long n = STEADY_BATCHES * k, i;
+    steady_init(&st);
+    for (i = 0; i < n; i++)
+      steady_add(&st, (double) i);
+
+    CHECK(st.partial_count == 0, "%ld observation(s) left outside a batch", st.partial_count);
+    CHECK(st.num_batches * st.batch_size == n, "%d batches of %ld hold %ld observations, not %ld",
+	  st.num_batches, st.batch_size, st.num_batches * st.batch_size, n);
+    // batch j of size b holds j*b .. j*b + b - 1, whose mean is below
+    for (j = 0; j < st.num_batches; j++) {
+      double want = j * (double) st.batch_size + (st.batch_size - 1) / 2.0;
+      CHECK(fabs(st.batch[j] - want) < 1e-6, "after %ld observations, batch %d has mean %.3f, "
+	    "not %.3f", n, j, st.batch[j], want);
+    }
+  }
+  return 0;
+}
+
+/* Checks that the analytic screen charges a batch limit's switch-overs:
+ * at 5 cars per minute the bridge copes with exhaustive service, but a
+ * limit of 10 cars forces a switch-over for every 10 and saturates it
+ *
+ * @return 0 if the check passed, -1 otherwise
+ */
+static int check_analytic_batch_limit(void) {
+  scenario_t sc;
+  analytic_t unlimited, limited;
+
+  scenario_defaults(&sc);
+  sc.rate[TO_HANOVER] = sc.rate[TO_NORWICH] = 2.5;
+  analytic_estimate(&sc, &unlimited);
+  sc.batch_limit = 10;
+  analytic_estimate(&sc, &limited);
+
+  CHECK(unlimited.stable && unlimited.utilisation < 0.9, "exhaustive service has utilisation %.3f",
+	unlimited.utilisation);
+  CHECK(limited.utilisation >= 0.98, "a batch limit of 10 leaves utilisation at %.3f, "
+	"so the sweep would simulate it", limited.utilisation);
+  sc.batch_limit = 30;
+  analytic_estimate(&sc, &limited);
+  CHECK(limited.stable && limited.mean_wait > unlimited.mean_wait,
+	"a batch limit of 30 predicts %.1fs against %.1fs without one", limited.mean_wait,
+	unlimited.mean_wait);
+  return 0;
+}
+
+/************************* MAIN ****************************/
+
+/* Runs every check
+ *
+ * @return 0 if all passed, 1 otherwise
+ */
+int main(void) {
+  static int (*const checks[])(void) = {
+    check_steady_batches,
+    check_analytic_batch_limit,
+  };
+  int num_checks = sizeof(checks) / sizeof(checks[0]);
+  int i, failed = 0;
+
+  for (i = 0; i < num_checks; i++) {
+    if (checks[i]())
+      failed++;
+  }
+  printf("%d check(s) run, %d failed\n", num_checks, failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,906 @@
+/* Purpose: Discrete-event engine for the Ledyard Bridge Construction Zone
+ *
+ * Cars arrive as a Poisson process whose direction is drawn from the two
+ * towns' arrival rates, wait in a FIFO lobby per direction, and spend a
+ * uniformly distributed time on the bridge. Scheduled incidents close the
+ * bridge or reduce its capacity for a while; the engine records how long
+ * the queues take to return to their pre-incident level afterwards.
+ *
+ * A ramp meter in front of a lobby lets cars through at a set rate with
+ * a set burst, by the generic cell rate algorithm: each meter keeps the
+ * theoretical arrival time (TAT) of its next car, and a car may pass once
+ * the clock is within the burst tolerance of it. Held cars wait in a FIFO
+ * per meter with a single release event pending for its head, so a meter
+ * costs a constant amount of work per car however many it holds.
+ *
+ * With route choice, an arriving driver may take the detour instead,
+ * judging the queue from a copy of the lobby and meter sizes that is
+ * refreshed at most every detour_lag.
+ *
+ * Impatient drivers turn back on arrival if balk_queue cars are already
+ * queued ahead of them, or give up after an exponentially distributed
+ * patience in the lobby. Each waiting car holds a cancellable timer in the
+ * event queue, cancelled in O(log n) when it boards; a car whose timer
+ * fires leaves its lobby, a doubly linked list, in O(1). Cars that give
+ * up are not traced past their arrival (or release), since the compact
+ * trace encoding has room for only four event types.
+ */
+
+#define _POSIX_C_SOURCE 200809L // for fileno()
+
+#include <stdio.h>
+#include <math.h>   // for log()
+#include <stdlib.h> // for malloc()
+#include <string.h> // for memset()
+#include "des.h"
+#include "eventq.h"
+#include "rng.h"
+#include "outbuf.h"
+#include "trace.h"
+#include "window.h"
+#include "steady.h"
+#include "hourly.h"
+#include "route.h"
+#include "arrow.h"
+
+// event types
+#define EV_ARRIVE 0         // next car arrives; arg unused
+#define EV_EXIT 1           // a car exits; arg = car slot
+#define EV_SWITCH 2         // a direction change has cleared; arg unused
+#define EV_INCIDENT_START 3 // arg = incident index
+#define EV_INCIDENT_END 4   // arg = incident index
+#define EV_RELEASE 5        // a ramp meter lets its first car go; arg = direction
+#define EV_RENEGE 6         // a waiting driver runs out of patience; arg = car slot
+
+#define NO_SLOT -1
+
+// columns of the per-car Arrow table
+#define COL_CAR 0
+#define COL_DIR 1
+#define COL_ARRIVE 2
+#define COL_RELEASE 3
+#define COL_BOARD 4
+#define COL_EXIT 5
+
+static const arrow_column_t car_columns[] = {
+  { "car", ARROW_UINT64 },
+  { "dir", ARROW_INT8 },             // TO_HANOVER or TO_NORWICH
+  { "arrive", ARROW_DURATION_US },   // reached the lobby or its meter
+  { "release", ARROW_DURATION_US },  // joined the lobby (= arrive unless metered)
+  { "board", ARROW_DURATION_US },
+  { "exit", ARROW_DURATION_US },
+};
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for a car known to the engine
+typedef struct des_car {
+  uint64_t id;       // order of arrival, starting at 0
+  sim_time_t arrive; // when the car joined the waiting lobby or its meter
+  sim_time_t reached; // when the car arrived, before any meter
+  sim_time_t boarded; // when the car got on the bridge
+  int dir;           // intended direction
+  int next;          // next slot in the same lobby, meter or free list
+  int prev;          // previous slot in the same lobby
+  int timer;         // the car's patience timer while it waits, or
+                     // EVENTQ_NO_TIMER
+  int traced;        // nonzero if the car's events go to the trace
+} des_car_t;
+
+// define a data structure for the whole state of one run
+typedef struct des {
+  const scenario_t* sc; // the scenario being simulated
+  sim_result_t* res;    // metrics being collected
+  rng_t rng;            // random stream for the run
+  const double* rate;   // arrival rates sampled, the scenario's unless tilted
+  double peak;          // highest total rate of a demand calendar (0 = none)
+  des_tilt_t* tilt;     // importance sampling state, or NULL
+  des_script_t* script; // cars to replay instead of drawing them, or NULL
+  double log_lr;        // log likelihood ratio of arrivals so far, if tilted
+  eventq_t events;      // pending events
+  outbuf_t out;         // verbose messages, when the scenario asks for them
+  trace_writer_t trace; // per-car events, when the scenario asks for them
+  uint64_t trace_limit; // cars whose id hashes at most this are traced
+  arrow_writer_t cars_out; // one row per crossed car, when the scenario asks
+  window_t win;         // rolling metrics, when the scenario asks for them
+  hourly_t hours;       // per-hour metrics, when the scenario asks for them
+  sim_time_t next_report; // when rolling metrics are next printed
+  steady_t wait_obs;    // waits, for steady-state stats
+  steady_t queue_obs;   // queue found at arrival, for steady-state stats
+  sim_time_t now;       // current simulated time
+  sim_time_t last_change; // when the lobby sizes last changed
+
+  des_car_t* cars;      // car slots, recycled through free_slot
+  int num_slots;        // allocated car slots
+  int free_slot;        // head of the free list of car slots
+  int head[NUM_DIRECTIONS];    // first car waiting towards each town
+  int tail[NUM_DIRECTIONS];    // last car waiting towards each town
+  int waiting[NUM_DIRECTIONS]; // cars waiting towards each town
+  int meter_head[NUM_DIRECTIONS]; // first car held at each ramp meter
+  int meter_tail[NUM_DIRECTIONS]; // last car held at each ramp meter
+  int held[NUM_DIRECTIONS];       // cars held at each ramp meter
+  sim_time_t meter_tat[NUM_DIRECTIONS]; // theoretical arrival time of the
+                                 // next car each meter lets through
+  int seen[NUM_DIRECTIONS];      // queues as drivers last saw them
+  sim_time_t seen_at;            // when seen was refreshed
+
+  int dir;              // current direction of traffic
+  int last_dir;         // direction of the last traffic flow
+  int num_cars;         // cars currently on the bridge
+  int capacity;         // current capacity, lowered by incidents
+  int closed;           // number of active closures
+  int switching;        // nonzero while traffic is changing direction
+  long flow_count;      // cars boarded since traffic started this way
+  long scheduled;       // arrivals scheduled so far
+
+  int active[MAX_INCIDENTS];     // nonzero while an incident is active
+  int recovering[MAX_INCIDENTS]; // nonzero from incident end to recovery
+  sim_time_t ended[MAX_INCIDENTS]; // when each incident ended
+  int num_recovering;   // incidents still waiting to recover
+  int num_active;       // incidents currently active
+  double normal_area;   // lobby size integrated over undisturbed time
+  sim_time_t normal_time; // time with no incident active or recovering
+} des_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Returns a free car slot, growing the slots if needed
+ *
+ * @return the slot index, or NO_SLOT on allocation error
+ */
+static int alloc_slot(des_t* s) {
+  if (s->free_slot == NO_SLOT) {
+    int grown_slots = s->num_slots ? 2 * s->num_slots : 64;
+    des_car_t* grown = (des_car_t*) realloc(s->cars, grown_slots * sizeof(des_car_t));
+    if (grown == NULL) {
+      fprintf(stderr, "Error growing car slots\n");
+      return NO_SLOT;
+    }
+    int i;
+    for (i = s->num_slots; i < grown_slots; i++)
+      grown[i].next = i + 1 < grown_slots ? i + 1 : NO_SLOT;
+    s->cars = grown;
+    s->free_slot = s->num_slots;
+    s->num_slots = grown_slots;
+  }
+  int slot = s->free_slot;
+  s->free_slot = s->cars[slot].next;
+  return slot;
+}
+
+/* Returns a car slot to the free list */
+static void free_slot(des_t* s, int slot) {
+  s->cars[slot].next = s->free_slot;
+  s->free_slot = slot;
+}
+
+/* Accumulates the waiting lobby's size over time up to now; must be
+ * called before the lobby sizes or incident states change. Time spent
+ * with no incident active or recovering also feeds the incident baseline
+ */
+static void account_queue(des_t* s) {
+  int queued = s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH];
+  double area = (double) queued * (s->now - s->last_change) / SIM_SEC;
+  s->res->queue_area += area;
+  if (s->num_active == 0 && s->num_recovering == 0) {
+    s->normal_area += area;
+    s->normal_time += s->now - s->last_change;
+  }
+  s->last_change = s->now;
+}
+
+/* Marks incidents as recovered once the lobby is back at their baseline */
+static void check_recovery(des_t* s) {
+  if (s->num_recovering == 0)
+    return;
+  int queued = s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH];
+  int i;
+  for (i = 0; i < s->sc->num_incidents; i++) {
+    if (s->recovering[i] && queued <= s->res->baseline[i]) {
+      account_queue(s);
+      s->res->recovery[i] = s->now - s->ended[i];
+      s->recovering[i] = 0;
+      s->num_recovering--;
+    }
+  }
+}
+
+/* Recomputes the bridge capacity from the active capacity incidents */
+static void update_capacity(des_t* s) {
+  int i;
+  s->capacity = s->sc->capacity;
+  for (i = 0; i < s->sc->num_incidents; i++) {
+    const incident_t* inc = &s->sc->incidents[i];
+    if (s->active[i] && inc->type == INCIDENT_CAPACITY && inc->capacity < s->capacity)
+      s->capacity = inc->capacity;
+  }
+}
+
+/* Schedules the next car arrival unless the run's limits are reached
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int schedule_arrival(des_t* s) {
+  if (s->script) {
+    if (s->scheduled >= s->script->n)
+      return 0;
+    return eventq_push(&s->events, s->script->cars[s->scheduled++].arrive, EV_ARRIVE, 0);
+  }
+
+  double rate = s->peak > 0 ? s->peak : s->rate[TO_HANOVER] + s->rate[TO_NORWICH];
+  if (s->sc->cars && s->scheduled >= s->sc->cars)
+    return 0;
+
+  // a calendar's arrivals are drawn at its peak rate, and each is kept
+  // with the chance that the rate at its time bears to the peak
+  sim_time_t when = s->now;
+  do {
+    when += (sim_time_t) rng_exponential(&s->rng, (double) SIM_MIN / rate);
+    if (s->sc->horizon && when > s->sc->horizon)
+      return 0;
+  } while (s->peak > 0 && rng_uniform(&s->rng) * s->peak >=
+	   scenario_rate(s->sc, TO_HANOVER, when) + scenario_rate(s->sc, TO_NORWICH, when));
+
+  s->scheduled++;
+  return eventq_push(&s->events, when, EV_ARRIVE, 0);
+}
+
+/* Returns the log likelihood ratio of the arrivals up to time t: the
+ * product over arrivals of nominal/tilted rate, times the ratio of the
+ * chances of no further arrival until t (arrivals stop at the horizon)
+ */
+static double log_lr_at(des_t* s, sim_time_t t) {
+  double nominal = s->sc->rate[TO_HANOVER] + s->sc->rate[TO_NORWICH];
+  double tilted = s->rate[TO_HANOVER] + s->rate[TO_NORWICH];
+  if (t > s->sc->horizon)
+    t = s->sc->horizon;
+  return s->log_lr - (nominal - tilted) * ((double) t / SIM_MIN);
+}
+
+/* Records one car event in the trace file, if the car is traced, and in
+ * the script's log, if any
+ */
+static void record(des_t* s, const des_car_t* car, int type) {
+  if (car->traced)
+    trace_write(&s->trace, s->now, car->id, type, car->dir);
+  if (s->script && s->script->log) {
+    trace_record_t* rec = &s->script->log[s->script->log_len++];
+    rec->time = s->now;
+    rec->car = car->id;
+    rec->type = type;
+    rec->dir = car->dir;
+    rec->seq = s->script->log_len; // the log is already in order
+  }
+}
+
+/* Adds a crossed car's row to the per-car Arrow table
+ *
+ * @return 0 on success, -1 on write error
+ */
+static int write_car(des_t* s, const des_car_t* car) {
+  arrow_writer_t* aw = &s->cars_out;
+  arrow_set_int(aw, COL_CAR, (int64_t) car->id);
+  arrow_set_int(aw, COL_DIR, car->dir);
+  arrow_set_int(aw, COL_ARRIVE, car->reached);
+  arrow_set_int(aw, COL_RELEASE, car->arrive);
+  arrow_set_int(aw, COL_BOARD, car->boarded);
+  arrow_set_int(aw, COL_EXIT, s->now);
+  return arrow_end_row(aw);
+}
+
+/* Picks the direction to serve once the bridge is empty: the other
+ * direction if anyone waits there, otherwise the same direction again
+ *
+ * @return the direction, or NO_DIRECTION if no car is waiting
+ */
+static int choose_direction(des_t* s) {
+  int other = s->last_dir == TO_HANOVER ? TO_NORWICH : TO_HANOVER;
+  if (s->waiting[other] > 0)
+    return other;
+  if (s->waiting[1 - other] > 0)
+    return 1 - other;
+  return NO_DIRECTION;
+}
+
+/* Moves the first waiting car in the current direction onto the bridge
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int board(des_t* s) {
+  int d = s->dir;
+  int slot = s->head[d];
+  des_car_t* car = &s->cars[slot];
+
+  account_queue(s);
+  s->head[d] = car->next;
+  if (s->head[d] == NO_SLOT)
+    s->tail[d] = NO_SLOT;
+  else
+    s->cars[s->head[d]].prev = NO_SLOT;
+  s->waiting[d]--;
+  s->num_cars++;
+  if (car->timer != EVENTQ_NO_TIMER) {
+    eventq_cancel(&s->events, car->timer);
+    car->timer = EVENTQ_NO_TIMER;
+  }
+  car->boarded = s->now;
+
+  sim_time_t wait = s->now - car->arrive;
+  double wait_sec = (double) wait / SIM_SEC;
+  s->res->wait_sum += wait_sec;
+  s->res->wait_sumsq += wait_sec * wait_sec;
+  if (wait > s->res->wait_max)
+    s->res->wait_max = wait;
+  if (s->tilt && wait > s->tilt->threshold) {
+    s->tilt->hits++;
+    s->tilt->weighted_hits += exp(log_lr_at(s, s->now));
+  }
+  if (s->sc->steady)
+    steady_add(&s->wait_obs, wait_sec);
+  if (s->sc->window_report) {
+    window_board(&s->win, s->now, wait);
+    window_queue(&s->win, s->now, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]);
+  }
+  if (s->sc->hourly &&
+      hourly_board(&s->hours, s->now, wait, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]))
+    return -1;
+
+  if (car->traced) {
+    s->res->traced++;
+    s->res->traced_wait_sum += wait_sec;
+    s->res->traced_wait_sumsq += wait_sec * wait_sec;
+  }
+  record(s, car, TRACE_BOARD);
+  if (s->sc->verbose) {
+    outbuf_board(&s->out, d);
+    outbuf_bridge(&s->out, s->num_cars, dir_name(d),
+		  s->waiting[TO_HANOVER], s->waiting[TO_NORWICH]);
+  }
+
+  check_recovery(s);
+  sim_time_t cross = s->script ? s->script->cars[car->id].cross :
+    rng_range(&s->rng, s->sc->cross_min, s->sc->cross_max);
+  return eventq_push(&s->events, s->now + cross, EV_EXIT, slot);
+}
+
+/* Boards as many waiting cars as the bridge state allows, starting a
+ * change of direction first if the bridge is empty
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int try_admit(des_t* s) {
+  if (s->closed || s->switching)
+    return 0;
+
+  // every driver the bridge cleared for may have given up meanwhile
+  if (s->num_cars == 0 && s->dir != NO_DIRECTION && s->waiting[s->dir] == 0) {
+    s->last_dir = s->dir;
+    s->dir = NO_DIRECTION;
+  }
+  if (s->num_cars == 0 && s->dir == NO_DIRECTION) {
+    int next = choose_direction(s);
+    if (next == NO_DIRECTION)
+      return 0;
+    s->dir = next;
+    s->flow_count = 0;
+    if (s->last_dir != NO_DIRECTION && next != s->last_dir) {
+      s->res->switches++;
+      if (s->sc->hourly && hourly_switch(&s->hours, s->now))
+	return -1;
+      if (s->sc->switch_time > 0) {
+	s->switching = 1;
+	return eventq_push(&s->events, s->now + s->sc->switch_time, EV_SWITCH, 0);
+      }
+    }
+  }
+
+  while (s->dir != NO_DIRECTION && s->waiting[s->dir] > 0 && s->num_cars < s->capacity) {
+    // once batch_limit cars have gone this way, stop boarding to let the
+    // bridge empty if anyone is waiting the other way
+    if (s->sc->batch_limit && s->flow_count >= s->sc->batch_limit &&
+	s->waiting[1 - s->dir] > 0)
+      break;
+    if (board(s))
+      return -1;
+    s->flow_count++;
+  }
+  return 0;
+}
+
+/* Puts a car at the back of its direction's lobby and boards what the
+ * bridge state allows
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int join_lobby(des_t* s, int slot) {
+  des_car_t* car = &s->cars[slot];
+  int d = car->dir;
+  car->next = NO_SLOT;
+  car->prev = s->tail[d];
+  car->timer = EVENTQ_NO_TIMER;
+
+  account_queue(s);
+  if (s->sc->steady)
+    steady_add(&s->queue_obs, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]);
+  if (s->tail[d] == NO_SLOT)
+    s->head[d] = slot;
+  else
+    s->cars[s->tail[d]].next = slot;
+  s->tail[d] = slot;
+  s->waiting[d]++;
+  if (s->waiting[d] > s->res->max_queue[d])
+    s->res->max_queue[d] = s->waiting[d];
+  if (s->sc->window_report)
+    window_queue(&s->win, s->now, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]);
+  if (s->sc->hourly &&
+      hourly_arrive(&s->hours, s->now, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]))
+    return -1;
+
+  if (s->sc->verbose)
+    outbuf_arrive(&s->out, d);
+  if (s->sc->patience > 0) {
+    sim_time_t patience = (sim_time_t) rng_exponential(&s->rng, (double) s->sc->patience);
+    if (eventq_push_timer(&s->events, s->now + patience, EV_RENEGE, slot, &car->timer))
+      return -1;
+  }
+  return try_admit(s);
+}
+
+/* Returns the interval a ramp meter keeps between cars */
+static sim_time_t meter_interval(des_t* s, int d) {
+  return (sim_time_t) (SIM_MIN / s->sc->meter_rate[d]);
+}
+
+/* Returns the earliest time a ramp meter lets its next car through */
+static sim_time_t meter_due(des_t* s, int d) {
+  sim_time_t due = s->meter_tat[d] - (s->sc->meter_burst[d] - 1) * meter_interval(s, d);
+  return due > s->now ? due : s->now;
+}
+
+/* Charges a ramp meter for letting one car through now */
+static void meter_pass(des_t* s, int d) {
+  sim_time_t tat = s->meter_tat[d] > s->now ? s->meter_tat[d] : s->now;
+  s->meter_tat[d] = tat + meter_interval(s, d);
+}
+
+/* Passes a newly arrived car through its direction's ramp meter, if any:
+ * straight into the lobby if the meter allows it now, otherwise to the
+ * back of the meter's queue
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+static int meter_arrive(des_t* s, int slot) {
+  int d = s->cars[slot].dir;
+  if (s->sc->meter_rate[d] <= 0)
+    return join_lobby(s, slot);
+  if (s->held[d] == 0 && meter_due(s, d) == s->now) {
+    meter_pass(s, d);
+    return join_lobby(s, slot);
+  }
+
+  s->cars[slot].next = NO_SLOT;
+  if (s->meter_tail[d] == NO_SLOT)
+    s->meter_head[d] = slot;
+  else
+    s->cars[s->meter_tail[d]].next = slot;
+  s->meter_tail[d] = slot;
+  s->res->metered[d]++;
+  if (++s->held[d] > s->res->max_held[d])
+    s->res->max_held[d] = s->held[d];
+  // only the head of the queue has a release pending
+  if (s->held[d] == 1)
+    return eventq_push(&s->events, meter_due(s, d), EV_RELEASE, d);
+  return 0;
+}
+
+/* Decides whether a driver heading towards d takes the detour, from the
+ * queues as last seen
+ *
+ * @return nonzero to take the detour
+ */
+static int take_detour(des_t* s, int d) {
+  if (s->now >= s->seen_at + s->sc->detour_lag) {
+    s->seen[TO_HANOVER] = s->waiting[TO_HANOVER] + s->held[TO_HANOVER];
+    s->seen[TO_NORWICH] = s->waiting[TO_NORWICH] + s->held[TO_NORWICH];
+    s->seen_at = s->now;
+  }
+  return route_detour(s->sc, s->seen[d], rng_uniform(&s->rng));
+}
+
+/****************************** EVENTS ******************************/
+
+/* Handles a new car joining the waiting lobby or its ramp meter */
+static int on_arrive(des_t* s) {
+  uint64_t id = s->res->arrived[TO_HANOVER] + s->res->arrived[TO_NORWICH];
+  double hanover = s->peak > 0 ? scenario_rate(s->sc, TO_HANOVER, s->now) : s->rate[TO_HANOVER];
+  double total = hanover + (s->peak > 0 ? scenario_rate(s->sc, TO_NORWICH, s->now) : s->rate[TO_NORWICH]);
+  int d = s->script ? s->script->cars[id].dir :
+    rng_uniform(&s->rng) * total < hanover ? TO_HANOVER : TO_NORWICH;
+  if (s->tilt)
+    s->log_lr += log(s->sc->rate[d] / s->rate[d]);
+  if (s->sc->detour_queue > 0 && take_detour(s, d)) {
+    s->res->detoured[d]++;
+    return schedule_arrival(s);
+  }
+  // a driver balks at the cars queued ahead, at the meter and in the lobby
+  if (s->sc->balk_queue > 0 && s->held[d] + s->waiting[d] >= s->sc->balk_queue) {
+    s->res->balked[d]++;
+    if (s->sc->hourly && hourly_balk(&s->hours, s->now))
+      return -1;
+    return schedule_arrival(s);
+  }
+  int slot = alloc_slot(s);
+  if (slot == NO_SLOT)
+    return -1;
+
+  des_car_t* car = &s->cars[slot];
+  car->id = id;
+  car->arrive = s->now;
+  car->reached = s->now;
+  car->dir = d;
+  car->traced = s->sc->trace[0] && trace_sampled(id, s->trace_limit);
+  s->res->arrived[d]++;
+  record(s, car, TRACE_ARRIVE);
+
+  if (schedule_arrival(s))
+    return -1;
+  return meter_arrive(s, slot);
+}
+
+/* Handles a ramp meter letting its first held car into the lobby */
+static int on_release(des_t* s, int d) {
+  int slot = s->meter_head[d];
+  des_car_t* car = &s->cars[slot];
+  s->meter_head[d] = car->next;
+  if (s->meter_head[d] == NO_SLOT)
+    s->meter_tail[d] = NO_SLOT;
+  s->held[d]--;
+  meter_pass(s, d);
+
+  // the wait for the bridge starts once the meter lets the car go
+  sim_time_t delay = s->now - car->arrive;
+  s->res->meter_delay_sum += (double) delay / SIM_SEC;
+  if (delay > s->res->meter_delay_max)
+    s->res->meter_delay_max = delay;
+  car->arrive = s->now;
+  record(s, car, TRACE_RELEASE);
+
+  if (s->held[d] > 0 && eventq_push(&s->events, meter_due(s, d), EV_RELEASE, d))
+    return -1;
+  return join_lobby(s, slot);
+}
+
+/* Handles a waiting driver running out of patience: the car leaves the
+ * middle of its lobby, and only cars its leaving unblocks (those held
+ * back for it by the batch limit) board
+ */
+static int on_renege(des_t* s, int slot) {
+  des_car_t* car = &s->cars[slot];
+  int d = car->dir;
+
+  car->timer = EVENTQ_NO_TIMER; // the handle was freed as the timer fired
+  account_queue(s);
+  if (car->prev == NO_SLOT)
+    s->head[d] = car->next;
+  else
+    s->cars[car->prev].next = car->next;
+  if (car->next == NO_SLOT)
+    s->tail[d] = car->prev;
+  else
+    s->cars[car->next].prev = car->prev;
+  s->waiting[d]--;
+  s->res->reneged[d]++;
+  s->res->renege_wait_sum += (double) (s->now - car->arrive) / SIM_SEC;
+  if (s->sc->window_report)
+    window_queue(&s->win, s->now, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]);
+  if (s->sc->hourly &&
+      hourly_renege(&s->hours, s->now, s->waiting[TO_HANOVER] + s->waiting[TO_NORWICH]))
+    return -1;
+  free_slot(s, slot);
+  return try_admit(s);
+}
+
+/* Handles a car leaving the bridge */
+static int on_exit(des_t* s, int slot) {
+  int d = s->cars[slot].dir;
+  record(s, &s->cars[slot], TRACE_EXIT);
+  if (s->sc->arrow[0] && write_car(s, &s->cars[slot]))
+    return -1;
+  free_slot(s, slot);
+  s->num_cars--;
+  s->res->crossed[d]++;
+  s->res->end_time = s->now;
+  if (s->sc->window_report)
+    window_exit(&s->win, s->now);
+  if (s->sc->hourly && hourly_exit(&s->hours, s->now))
+    return -1;
+
+  if (s->sc->verbose)
+    outbuf_exit(&s->out, d);
+
+  if (s->num_cars == 0) {
+    s->last_dir = s->dir;
+    s->dir = NO_DIRECTION;
+  }
+  return try_admit(s);
+}
+
+/* Handles the start of a scheduled incident */
+static int on_incident_start(des_t* s, int i) {
+  account_queue(s);
+  s->res->baseline[i] = s->normal_time > 0 ? s->normal_area / ((double) s->normal_time / SIM_SEC) : 0.0;
+  s->active[i] = 1;
+  s->num_active++;
+  if (s->sc->incidents[i].type == INCIDENT_CLOSE)
+    s->closed++;
+  update_capacity(s);
+  return 0;
+}
+
+/* Handles the end of a scheduled incident */
+static int on_incident_end(des_t* s, int i) {
+  account_queue(s);
+  s->active[i] = 0;
+  s->num_active--;
+  if (s->sc->incidents[i].type == INCIDENT_CLOSE)
+    s->closed--;
+  update_capacity(s);
+
+  s->ended[i] = s->now;
+  s->recovering[i] = 1;
+  s->num_recovering++;
+  check_recovery(s);
+  return try_admit(s);
+}
+
+/* Prints the rolling metrics as of time when, keeping verbose messages
+ * that happened earlier ahead of the report
+ */
+static void report_window(des_t* s, sim_time_t when) {
+  if (s->sc->verbose)
+    outbuf_flush(&s->out);
+  window_print(stdout, &s->win, when);
+}
+
+/* Starts a run on the car slots and event heap left by earlier runs, with
+ * every slot free and no events pending
+ */
+static void adopt_storage(des_t* s, des_buffers_t* bufs) {
+  int i;
+  s->cars = bufs->cars;
+  s->num_slots = bufs->num_slots;
+  for (i = 0; i < s->num_slots; i++)
+    s->cars[i].next = i + 1 < s->num_slots ? i + 1 : NO_SLOT;
+  s->free_slot = s->num_slots ? 0 : NO_SLOT;
+  s->events = bufs->events;
+  eventq_clear(&s->events);
+}
+
+/* Hands a run's car slots and event heap back to the caller's buffers,
+ * grown as they may be, or frees them if the run had none
+ */
+static void release_storage(des_t* s, des_buffers_t* bufs) {
+  if (bufs) {
+    bufs->cars = s->cars;
+    bufs->num_slots = s->num_slots;
+    bufs->events = s->events;
+    return;
+  }
+  eventq_destroy(&s->events);
+  free(s->cars);
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+/* Runs one simulation, optionally tilted, scripted or on kept buffers;
+ * see des_run_tilted(), des_run_script() and des_run_warm()
+ */
+static int run(const scenario_t* sc, sim_result_t* res, des_tilt_t* tilt, des_script_t* script,
+	       des_buffers_t* bufs) {
+  des_t s;
+  event_t ev;
+  int i, rc = 0;
+
+  if (scenario_validate(sc))
+    return -1;
+  if (tilt && (sc->cars || !sc->horizon)) {
+    fprintf(stderr, "Error, tilted runs must be limited by horizon only\n");
+    return -1;
+  }
+  if (tilt && scenario_has_calendar(sc)) {
+    fprintf(stderr, "Error, tilted runs cannot follow a demand calendar\n");
+    return -1;
+  }
+  if (script && (sc->meter_rate[TO_HANOVER] > 0 || sc->meter_rate[TO_NORWICH] > 0)) {
+    fprintf(stderr, "Error, scripted runs cannot be metered\n");
+    return -1;
+  }
+  if (script && sc->detour_queue > 0) {
+    fprintf(stderr, "Error, scripted runs cannot use route choice\n");
+    return -1;
+  }
+  if (script && (sc->balk_queue > 0 || sc->patience > 0)) {
+    fprintf(stderr, "Error, scripted runs cannot have drivers balk or renege\n");
+    return -1;
+  }
+
+  memset(&s, 0, sizeof(s));
+  memset(res, 0, sizeof(*res));
+  s.sc = sc;
+  s.res = res;
+  s.rate = tilt ? tilt->rate : sc->rate;
+  s.peak = tilt || !scenario_has_calendar(sc) ? 0.0 : scenario_peak_rate(sc);
+  s.tilt = tilt;
+  s.script = script;
+  if (script)
+    script->log_len = 0;
+  if (tilt) {
+    tilt->weighted_hits = 0;
+    tilt->hits = 0;
+  }
+  rng_seed(&s.rng, sc->seed);
+  s.free_slot = NO_SLOT;
+  s.head[TO_HANOVER] = s.head[TO_NORWICH] = NO_SLOT;
+  s.tail[TO_HANOVER] = s.tail[TO_NORWICH] = NO_SLOT;
+  s.meter_head[TO_HANOVER] = s.meter_head[TO_NORWICH] = NO_SLOT;
+  s.meter_tail[TO_HANOVER] = s.meter_tail[TO_NORWICH] = NO_SLOT;
+  s.dir = s.last_dir = NO_DIRECTION;
+  s.capacity = sc->capacity;
+  window_init(&s.win);
+  hourly_init(&s.hours);
+  steady_init(&s.wait_obs);
+  steady_init(&s.queue_obs);
+  s.next_report = sc->window_report;
+  s.trace_limit = trace_sample_limit(sc->trace_sample);
+  res->num_incidents = sc->num_incidents;
+  if (bufs)
+    adopt_storage(&s, bufs);
+  else if (eventq_init(&s.events, 64))
+    return -1;
+  if (sc->verbose && outbuf_init(&s.out, fileno(stdout), 0)) {
+    release_storage(&s, bufs);
+    return -1;
+  }
+  if (sc->trace[0] && trace_open(&s.trace, sc->trace, sc->trace_format)) {
+    if (sc->verbose)
+      outbuf_destroy(&s.out);
+    release_storage(&s, bufs);
+    return -1;
+  }
+  if (sc->arrow[0] &&
+      arrow_open(&s.cars_out, sc->arrow, car_columns, sizeof(car_columns) / sizeof(car_columns[0]))) {
+    if (sc->trace[0])
+      trace_close(&s.trace);
+    if (sc->verbose)
+      outbuf_destroy(&s.out);
+    release_storage(&s, bufs);
+    return -1;
+  }
+
+  for (i = 0; i < sc->num_incidents && rc == 0; i++) {
+    res->recovery[i] = -1;
+    rc = eventq_push(&s.events, sc->incidents[i].start, EV_INCIDENT_START, i) ||
+      eventq_push(&s.events, sc->incidents[i].start + sc->incidents[i].duration, EV_INCIDENT_END, i);
+  }
+  if (rc == 0)
+    rc = schedule_arrival(&s);
+
+  while (rc == 0 && eventq_pop(&s.events, &ev) == 0) {
+    while (sc->window_report && s.next_report <= ev.time) {
+      report_window(&s, s.next_report);
+      s.next_report += sc->window_report;
+    }
+    s.now = ev.time;
+    switch (ev.type) {
+    case EV_ARRIVE:
+      rc = on_arrive(&s);
+      break;
+    case EV_EXIT:
+      rc = on_exit(&s, ev.arg);
+      break;
+    case EV_SWITCH:
+      s.switching = 0;
+      rc = try_admit(&s);
+      break;
+    case EV_INCIDENT_START:
+      rc = on_incident_start(&s, ev.arg);
+      break;
+    case EV_INCIDENT_END:
+      rc = on_incident_end(&s, ev.arg);
+      break;
+    case EV_RELEASE:
+      rc = on_release(&s, ev.arg);
+      break;
+    case EV_RENEGE:
+      rc = on_renege(&s, ev.arg);
+      break;
+    }
+  }
+
+  if (rc == 0 && sc->window_report)
+    report_window(&s, res->end_time);
+  if (rc == 0 && sc->hourly) {
+    if (sc->verbose)
+      outbuf_flush(&s.out);
+    hourly_print(stdout, &s.hours);
+  }
+  hourly_destroy(&s.hours);
+  if (tilt)
+    tilt->log_lr = log_lr_at(&s, sc->horizon);
+  if (rc == 0 && sc->steady)
+    res->steady_ok = steady_analyze(&s.wait_obs, &res->steady_wait) == 0 &&
+      steady_analyze(&s.queue_obs, &res->steady_queue) == 0;
+  if (sc->verbose && outbuf_destroy(&s.out))
+    rc = -1;
+  if (sc->trace[0] && trace_close(&s.trace))
+    rc = -1;
+  if (sc->arrow[0] && arrow_close(&s.cars_out))
+    rc = -1;
+  release_storage(&s, bufs);
+  return rc;
+}
+
+int des_run(const scenario_t* sc, sim_result_t* res) {
+  return run(sc, res, NULL, NULL, NULL);
+}
+
+int des_buffers_init(des_buffers_t* bufs) {
+  bufs->cars = NULL;
+  bufs->num_slots = 0;
+  return eventq_init(&bufs->events, 64);
+}
+
+void des_buffers_destroy(des_buffers_t* bufs) {
+  eventq_destroy(&bufs->events);
+  free(bufs->cars);
+  bufs->cars = NULL;
+  bufs->num_slots = 0;
+}
+
+int des_run_warm(const scenario_t* sc, sim_result_t* res, des_buffers_t* bufs) {
+  return run(sc, res, NULL, NULL, bufs);
+}
+
+int des_run_tilted(const scenario_t* sc, sim_result_t* res, des_tilt_t* tilt) {
+  return run(sc, res, tilt, NULL, NULL);
+}
+
+int des_run_script(const scenario_t* sc, sim_result_t* res, des_script_t* script) {
+  return run(sc, res, NULL, script, NULL);
+}
+
+int des_make_script(const scenario_t* sc, script_car_t** cars) {
+  double rate = scenario_peak_rate(sc);
+  sim_time_t now = 0;
+  rng_t rng;
+  long i;
+
+  if (scenario_validate(sc))
+    return -1;
+  if (sc->cars <= 0 || sc->cars > INT32_MAX) {
+    fprintf(stderr, "Error, a script needs a number of cars\n");
+    return -1;
+  }
+  *cars = (script_car_t*) malloc(sc->cars * sizeof(script_car_t));
+  if (*cars == NULL) {
+    fprintf(stderr, "Error allocating script cars\n");
+    return -1;
+  }
+
+  // each car's gap, direction and crossing time are drawn together, so
+  // car i is the same whatever the engine does with the others
+  rng_seed(&rng, sc->seed);
+  for (i = 0; i < sc->cars; i++) {
+    script_car_t* car = &(*cars)[i];
+    double hanover, total;
+    do { // thinned to a demand calendar's rate, as in schedule_arrival()
+      now += (sim_time_t) rng_exponential(&rng, (double) SIM_MIN / rate);
+      hanover = scenario_rate(sc, TO_HANOVER, now);
+      total = hanover + scenario_rate(sc, TO_NORWICH, now);
+    } while (scenario_has_calendar(sc) && rng_uniform(&rng) * rate >= total);
+    car->arrive = now;
+    car->dir = rng_uniform(&rng) * total < hanover ? TO_HANOVER : TO_NORWICH;
+    car->cross = rng_range(&rng, sc->cross_min, sc->cross_max);
+  }
+  return (int) sc->cars;
+}
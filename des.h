@@ -0,0 +1,117 @@
+/* Purpose: A discrete-event engine for the Ledyard Bridge Construction
+ * Zone. Instead of one thread and real sleep() calls per car, the engine
+ * keeps the bridge state of the threaded sim in a single structure and
+ * advances a simulated clock from event to event, so runs of millions of
+ * cars finish in seconds and are reproducible from their seed.
+ *
+ * The admission rules match arrive_bridge()/exit_bridge(): cars board
+ * while traffic flows their way and the bridge is below capacity, and the
+ * direction of traffic can only change once the bridge is empty. When it
+ * is empty, cars waiting in the other direction are served first. An
+ * optional batch limit stops boarding after that many cars have gone one
+ * way while others wait, so the bridge can empty and change direction.
+ */
+
+#ifndef DES_H
+#define DES_H
+
+#include "scenario.h"
+#include "trace.h"
+#include "eventq.h"
+
+/* Runs one simulation of a scenario to completion
+ *
+ * @param sc the scenario to simulate
+ * @param res where to save the run's metrics
+ * @return 0 on success, -1 on allocation error or invalid scenario
+ */
+int des_run(const scenario_t* sc, sim_result_t* res);
+
+// define a data structure for storage kept between runs, so a caller
+// running many scenarios back to back reuses the car slots and event heap
+// the earlier runs grew instead of allocating them again
+typedef struct des_buffers {
+  struct des_car* cars; // car slots, owned by the engine
+  int num_slots;        // allocated car slots
+  eventq_t events;      // the pending-event heap
+} des_buffers_t;
+
+/* Allocates empty buffers for des_run_warm()
+ *
+ * @param bufs the buffers to initialize
+ * @return 0 on success, -1 on allocation error
+ */
+int des_buffers_init(des_buffers_t* bufs);
+
+/* Frees the buffers' storage */
+void des_buffers_destroy(des_buffers_t* bufs);
+
+/* Runs one simulation like des_run(), on storage left by earlier runs
+ *
+ * @param sc the scenario to simulate
+ * @param res where to save the run's metrics
+ * @param bufs the storage to run on, which keeps any growth for next time
+ * @return 0 on success, -1 on allocation error or invalid scenario
+ */
+int des_run_warm(const scenario_t* sc, sim_result_t* res, des_buffers_t* bufs);
+
+// define a data structure for running the engine under importance
+// sampling: arrivals are drawn at tilted rates, and the likelihood ratio
+// back to the scenario's own rates is tracked so that rare long waits
+// can be counted with their correct weight
+typedef struct des_tilt {
+  double rate[NUM_DIRECTIONS]; // arrival rates actually sampled, cars/min
+  sim_time_t threshold; // waits longer than this are the rare event
+  double weighted_hits; // out: sum over cars waiting longer than threshold
+                        // of the likelihood ratio when they boarded
+  uint64_t hits;        // out: number of such cars, unweighted
+  double log_lr;        // out: log likelihood ratio of the whole run
+} des_tilt_t;
+
+/* Runs one simulation with arrivals drawn at tilted rates. The scenario
+ * must be limited by its horizon only, so the arrival process has a fixed
+ * observation window for the likelihood ratio
+ *
+ * @param sc the scenario to simulate; its rates are the nominal ones
+ * @param res where to save the run's metrics (under the tilted rates)
+ * @param tilt the rates to sample at; its outputs are filled in
+ * @return 0 on success, -1 on allocation error or invalid scenario
+ */
+int des_run_tilted(const scenario_t* sc, sim_result_t* res, des_tilt_t* tilt);
+
+// define a data structure for one car of a scripted run
+typedef struct script_car {
+  sim_time_t arrive; // when the car reaches the bridge
+  sim_time_t cross;  // how long the car spends on the bridge
+  int dir;           // intended direction
+} script_car_t;
+
+// define a data structure for replaying a fixed list of cars instead of
+// drawing arrivals, so another engine can be run on the same cars
+typedef struct des_script {
+  const script_car_t* cars; // the cars, in order of arrival
+  int n;                    // the number of cars
+  trace_record_t* log;      // out: every event in order (3 per car), or NULL
+  size_t log_len;           // out: events saved in log
+} des_script_t;
+
+/* Draws the cars a run of a scenario would see: Poisson arrivals at the
+ * scenario's rates and uniform crossing times, seeded by its seed
+ *
+ * @param sc the scenario, which must be limited by a number of cars
+ * @param cars where to save the allocated cars; the caller frees them
+ * @return the number of cars, or -1 on allocation error
+ */
+int des_make_script(const scenario_t* sc, script_car_t** cars);
+
+/* Runs one simulation of a scripted list of cars; the scenario's seed,
+ * rates, crossing times and car limit are not used
+ *
+ * @param sc the scenario giving capacity, policy and incidents
+ * @param res where to save the run's metrics
+ * @param script the cars to replay; its log is filled in if given
+ * @return 0 on success, -1 on allocation error or invalid scenario
+ */
+int des_run_script(const scenario_t* sc, sim_result_t* res, des_script_t* script);
+
+#endif // DES_H
@@ -0,0 +1,152 @@
+/* Purpose: Invariant checks and distribution tests for differential runs */
+
+#include <stdio.h>
+#include <stdlib.h> // for calloc(), qsort()
+#include <math.h>   // for exp(), round(), sqrt()
+#include "diff.h"
+
+// car states while replaying a log
+#define CAR_UNSEEN 0
+#define CAR_WAITING 1
+#define CAR_ON_BRIDGE 2
+#define CAR_DONE 3
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Orders doubles ascending, for qsort() */
+static int by_value(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/* Saves why a log failed its check, keeping only the first reason */
+static void fail(diff_log_t* out, const trace_record_t* rec, const char* what) {
+  if (!out->ok)
+    return;
+  out->ok = 0;
+  snprintf(out->why, sizeof(out->why), "%s (car %llu at %.3fs)", what,
+	   (unsigned long long) rec->car, (double) rec->time / SIM_SEC);
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+void diff_check(const trace_record_t* log, size_t len, int n, int capacity, int may_detour,
+		int may_renege, diff_log_t* out) {
+  int on_bridge[NUM_DIRECTIONS] = { 0, 0 };
+  sim_time_t last = 0;
+  int done = 0;
+  size_t i;
+
+  out->ok = 1;
+  out->why[0] = '\0';
+  out->max_on_bridge = 0;
+  out->detoured = 0;
+  out->reneged = 0;
+  char* state = (char*) calloc(n, 1);
+  sim_time_t* arrived = (sim_time_t*) calloc(n, sizeof(sim_time_t));
+  if (state == NULL || arrived == NULL) {
+    out->ok = 0;
+    snprintf(out->why, sizeof(out->why), "out of memory");
+    free(state);
+    free(arrived);
+    return;
+  }
+
+  for (i = 0; i < len && out->ok; i++) {
+    const trace_record_t* rec = &log[i];
+    if (rec->car >= (uint64_t) n || (rec->dir != TO_HANOVER && rec->dir != TO_NORWICH)) {
+      fail(out, rec, "unknown car or direction");
+      break;
+    }
+    if (rec->time < last)
+      fail(out, rec, "event logged out of time order");
+    last = rec->time;
+
+    int d = rec->dir;
+    char* st = &state[rec->car];
+    switch (rec->type) {
+    case TRACE_ARRIVE:
+      if (*st != CAR_UNSEEN)
+	fail(out, rec, "car arrived twice");
+      *st = CAR_WAITING;
+      arrived[rec->car] = rec->time;
+      break;
+    case TRACE_BOARD:
+      if (*st != CAR_WAITING)
+	fail(out, rec, "car boarded without waiting");
+      *st = CAR_ON_BRIDGE;
+      on_bridge[d]++;
+      if (on_bridge[1 - d] > 0)
+	fail(out, rec, "cars crossing in both directions");
+      if (on_bridge[d] > capacity)
+	fail(out, rec, "bridge over capacity");
+      if (on_bridge[d] > out->max_on_bridge)
+	out->max_on_bridge = on_bridge[d];
+      out->waits[rec->car] = (double) (rec->time - arrived[rec->car]) / SIM_SEC;
+      break;
+    case TRACE_EXIT:
+      if (*st != CAR_ON_BRIDGE)
+	fail(out, rec, "car exited without boarding");
+      *st = CAR_DONE;
+      on_bridge[d]--;
+      done++;
+      break;
+    default:
+      fail(out, rec, "unknown event");
+    }
+  }
+  for (i = 0; i < (size_t) n; i++) {
+    out->detoured += may_detour && state[i] == CAR_UNSEEN;
+    out->reneged += may_renege && state[i] == CAR_WAITING;
+  }
+  if (out->ok && done + out->detoured + out->reneged != n) {
+    out->ok = 0;
+    snprintf(out->why, sizeof(out->why), "only %d of %d cars crossed", done, n);
+  }
+
+  free(state);
+  free(arrived);
+}
+
+double diff_ks(double* a, int na, double* b, int nb, double resolution, double* d) {
+  int i = 0, j = 0, k;
+  double dmax = 0;
+
+  for (k = 0; k < na; k++)
+    a[k] = round(a[k] / resolution) * resolution;
+  for (k = 0; k < nb; k++)
+    b[k] = round(b[k] / resolution) * resolution;
+
+  qsort(a, na, sizeof(double), by_value);
+  qsort(b, nb, sizeof(double), by_value);
+
+  // walk both samples in order, stepping past ties in both at once
+  while (i < na && j < nb) {
+    double x = a[i] < b[j] ? a[i] : b[j];
+    while (i < na && a[i] == x)
+      i++;
+    while (j < nb && b[j] == x)
+      j++;
+    double dist = fabs((double) i / na - (double) j / nb);
+    if (dist > dmax)
+      dmax = dist;
+  }
+  *d = dmax;
+
+  // Kolmogorov's limiting distribution, with Stephens' small-sample
+  // correction of the statistic
+  double ne = (double) na * nb / (na + nb);
+  double lambda = (sqrt(ne) + 0.12 + 0.11 / sqrt(ne)) * dmax;
+  double p = 0, sign = 1;
+  if (lambda < 0.2)
+    return 1.0; // the series converges slowly here, and is 1 to 5 digits
+  for (k = 1; k <= 100; k++) {
+    double term = exp(-2.0 * k * k * lambda * lambda);
+    p += sign * term;
+    sign = -sign;
+    if (term < 1e-12)
+      break;
+  }
+  p *= 2;
+  return p < 0 ? 0 : p > 1 ? 1 : p;
+}
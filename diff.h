@@ -0,0 +1,72 @@
+/* Purpose: Differential testing of bridge engines. Two engines are run on
+ * the same scripted cars (des_make_script()) and each one's event log is
+ * checked on its own for the bridge's safety invariants:
+ *
+ *   - every car arrives, boards and exits exactly once, in that order,
+ *     unless route choice sent it on the detour or its driver balked and
+ *     it never appears, or its driver gave up waiting and it only arrives
+ *   - cars never cross in both directions at the same time
+ *   - the bridge never carries more than its capacity
+ *   - events are logged in time order
+ *
+ * The engines' waits are then compared with a two-sample
+ * Kolmogorov-Smirnov test, since thread scheduling makes the threaded
+ * engine's individual waits differ from the discrete-event ones even on
+ * identical arrivals.
+ */
+
+#ifndef DIFF_H
+#define DIFF_H
+
+#include "scenario.h"
+#include "trace.h"
+
+#define DIFF_WHY_LEN 128 // room for the reason a log failed its check
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for what one engine's event log showed
+typedef struct diff_log {
+  int ok;                  // nonzero if every invariant held
+  char why[DIFF_WHY_LEN];  // the first broken invariant, if not ok
+  int max_on_bridge;       // most cars on the bridge at once
+  int detoured;            // cars that never appeared, having taken the
+                           // detour or balked
+  int reneged;             // cars that arrived but gave up waiting
+  double* waits;           // each car's wait in seconds, by car id
+} diff_log_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Checks an engine's event log against the bridge's invariants and
+ * extracts every car's wait
+ *
+ * @param log the events, in the order the engine applied them
+ * @param len the number of events
+ * @param n the number of cars that should appear in the log
+ * @param capacity the most cars allowed on the bridge
+ * @param may_detour nonzero if cars may take the detour or balk and so
+ *        never appear in the log
+ * @param may_renege nonzero if drivers may give up waiting and so never
+ *        board
+ * @param out where to save the outcome; out->waits must hold n waits
+ */
+void diff_check(const trace_record_t* log, size_t len, int n, int capacity, int may_detour,
+		int may_renege, diff_log_t* out);
+
+/* Runs a two-sample Kolmogorov-Smirnov test. Both samples are rounded to
+ * the resolution and sorted in place; rounding keeps timing jitter from
+ * separating waits that are really equal, such as the zero waits of cars
+ * that found the bridge free
+ *
+ * @param a the first sample
+ * @param na its size
+ * @param b the second sample
+ * @param nb its size
+ * @param resolution values closer than this are not told apart
+ * @param d where to save the largest distance between the samples' CDFs
+ * @return the asymptotic p-value of d under equal distributions
+ */
+double diff_ks(double* a, int na, double* b, int nb, double resolution, double* d);
+
+#endif // DIFF_H
@@ -0,0 +1,174 @@
+/* Purpose: Binary min-heap of scheduled events for the discrete-event
+ * bridge engine
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for malloc()
+#include "eventq.h"
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Returns nonzero if event a must fire before event b */
+static int before(const event_t* a, const event_t* b) {
+  if (a->time != b->time)
+    return a->time < b->time;
+  return a->seq < b->seq;
+}
+
+/* Stores an event at index i, updating its timer's position if any */
+static void place(eventq_t* q, int i, const event_t* ev) {
+  q->heap[i] = *ev;
+  if (ev->timer != EVENTQ_NO_TIMER)
+    q->timers[ev->timer] = i;
+}
+
+/* Moves the event at index i up until the heap is ordered again */
+static void sift_up(eventq_t* q, int i) {
+  event_t ev = q->heap[i];
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!before(&ev, &q->heap[parent]))
+      break;
+    place(q, i, &q->heap[parent]);
+    i = parent;
+  }
+  place(q, i, &ev);
+}
+
+/* Moves the event at index i down until the heap is ordered again */
+static void sift_down(eventq_t* q, int i) {
+  event_t ev = q->heap[i];
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= q->size)
+      break;
+    if (child + 1 < q->size && before(&q->heap[child + 1], &q->heap[child]))
+      child++;
+    if (!before(&q->heap[child], &ev))
+      break;
+    place(q, i, &q->heap[child]);
+    i = child;
+  }
+  place(q, i, &ev);
+}
+
+/* Removes the event at index i, refilling the hole with the last event */
+static void remove_at(eventq_t* q, int i) {
+  if (q->heap[i].timer != EVENTQ_NO_TIMER) {
+    q->timers[q->heap[i].timer] = q->free_timer;
+    q->free_timer = q->heap[i].timer;
+  }
+  if (i == --q->size)
+    return;
+  place(q, i, &q->heap[q->size]);
+  if (i > 0 && before(&q->heap[i], &q->heap[(i - 1) / 2]))
+    sift_up(q, i);
+  else
+    sift_down(q, i);
+}
+
+/* Hands out a free timer handle, growing the handles if needed
+ *
+ * @return the handle, or EVENTQ_NO_TIMER on allocation error
+ */
+static int alloc_timer(eventq_t* q) {
+  int timer = q->free_timer;
+  if (timer != EVENTQ_NO_TIMER) {
+    q->free_timer = q->timers[timer];
+    return timer;
+  }
+  if (q->num_timers == q->timer_cap) {
+    int cap = q->timer_cap ? 2 * q->timer_cap : 64;
+    int* grown = (int*) realloc(q->timers, cap * sizeof(int));
+    if (grown == NULL) {
+      fprintf(stderr, "Error growing event queue timers\n");
+      return EVENTQ_NO_TIMER;
+    }
+    q->timers = grown;
+    q->timer_cap = cap;
+  }
+  return q->num_timers++;
+}
+
+/* Schedules an event with the given timer handle */
+static int push(eventq_t* q, sim_time_t time, int type, int arg, int timer) {
+  if (q->size == q->cap) {
+    event_t* grown = (event_t*) realloc(q->heap, 2 * q->cap * sizeof(event_t));
+    if (grown == NULL) {
+      fprintf(stderr, "Error growing event queue\n");
+      return -1;
+    }
+    q->heap = grown;
+    q->cap *= 2;
+  }
+
+  event_t* ev = &q->heap[q->size];
+  ev->time = time;
+  ev->seq = q->next_seq++;
+  ev->type = type;
+  ev->arg = arg;
+  ev->timer = timer;
+  sift_up(q, q->size++);
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int eventq_init(eventq_t* q, int cap) {
+  q->heap = (event_t*) malloc(cap * sizeof(event_t));
+  if (q->heap == NULL) {
+    fprintf(stderr, "Error allocating event queue\n");
+    return -1;
+  }
+  q->size = 0;
+  q->cap = cap;
+  q->next_seq = 0;
+  q->timers = NULL;
+  q->num_timers = q->timer_cap = 0;
+  q->free_timer = EVENTQ_NO_TIMER;
+  return 0;
+}
+
+void eventq_destroy(eventq_t* q) {
+  free(q->heap);
+  free(q->timers);
+  q->heap = NULL;
+  q->timers = NULL;
+  q->size = q->cap = 0;
+  q->num_timers = q->timer_cap = 0;
+}
+
+void eventq_clear(eventq_t* q) {
+  q->size = 0;
+  q->next_seq = 0;
+  q->num_timers = 0;
+  q->free_timer = EVENTQ_NO_TIMER;
+}
+
+int eventq_push(eventq_t* q, sim_time_t time, int type, int arg) {
+  return push(q, time, type, arg, EVENTQ_NO_TIMER);
+}
+
+int eventq_push_timer(eventq_t* q, sim_time_t time, int type, int arg, int* timer) {
+  if ((*timer = alloc_timer(q)) == EVENTQ_NO_TIMER)
+    return -1;
+  if (push(q, time, type, arg, *timer)) {
+    q->timers[*timer] = q->free_timer;
+    q->free_timer = *timer;
+    *timer = EVENTQ_NO_TIMER;
+    return -1;
+  }
+  return 0;
+}
+
+void eventq_cancel(eventq_t* q, int timer) {
+  remove_at(q, q->timers[timer]);
+}
+
+int eventq_pop(eventq_t* q, event_t* out) {
+  if (q->size == 0)
+    return -1;
+  *out = q->heap[0];
+  remove_at(q, 0);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/* Purpose: The pending-event set of the discrete-event bridge engine,
+ * a binary min-heap ordered by simulated time. Events scheduled for the
+ * same time are delivered in the order they were scheduled.
+ *
+ * An event may be scheduled as a timer, which can be cancelled before it
+ * fires. A timer's handle indexes a table of heap positions that every
+ * move within the heap keeps current, so cancelling finds the event in
+ * O(1) and removes it in O(log n), rather than leaving a stale event for
+ * the engine to skip when it surfaces.
+ */
+
+#ifndef EVENTQ_H
+#define EVENTQ_H
+
+#include <stdint.h>
+#include "scenario.h"
+
+#define EVENTQ_NO_TIMER -1 // the timer handle of an ordinary event
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one scheduled event
+typedef struct event {
+  sim_time_t time; // when the event fires
+  uint64_t seq;    // tie-breaker; order events were scheduled in
+  int type;        // what kind of event, interpreted by the engine
+  int arg;         // event argument, e.g. a car or incident index
+  int timer;       // the event's timer handle, or EVENTQ_NO_TIMER
+} event_t;
+
+// define a data structure for the pending-event set
+typedef struct eventq {
+  event_t* heap;     // heap[0] is the next event to fire
+  int size;          // number of pending events
+  int cap;           // allocated slots in heap
+  uint64_t next_seq; // seq given to the next scheduled event
+  int* timers;       // heap index of each pending timer, or for a free
+                     // handle, the next free handle
+  int num_timers;    // handles handed out so far
+  int timer_cap;     // allocated entries in timers
+  int free_timer;    // first free handle, or EVENTQ_NO_TIMER
+} eventq_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Initializes an empty event queue
+ *
+ * @param q the queue to initialize
+ * @param cap the initial number of slots (grows as needed)
+ * @return 0 on success, -1 on allocation error
+ */
+int eventq_init(eventq_t* q, int cap);
+
+/* Frees an event queue's storage */
+void eventq_destroy(eventq_t* q);
+
+/* Drops every pending event, keeping the storage for the next run
+ *
+ * @param q the queue to empty
+ */
+void eventq_clear(eventq_t* q);
+
+/* Schedules an event in O(log n)
+ *
+ * @param q the queue
+ * @param time when the event fires
+ * @param type the event's kind
+ * @param arg the event's argument
+ * @return 0 on success, -1 on allocation error
+ */
+int eventq_push(eventq_t* q, sim_time_t time, int type, int arg);
+
+/* Schedules an event that may be cancelled until it fires, in O(log n).
+ * The handle is freed when the event is popped or cancelled, and may then
+ * be given to another timer
+ *
+ * @param q the queue
+ * @param time when the event fires
+ * @param type the event's kind
+ * @param arg the event's argument
+ * @param timer where to save the timer's handle
+ * @return 0 on success, -1 on allocation error
+ */
+int eventq_push_timer(eventq_t* q, sim_time_t time, int type, int arg, int* timer);
+
+/* Cancels a pending timer in O(log n)
+ *
+ * @param q the queue
+ * @param timer the handle from eventq_push_timer(); the timer must not
+ *        have fired or been cancelled already
+ */
+void eventq_cancel(eventq_t* q, int timer);
+
+/* Removes the earliest event in O(log n)
+ *
+ * @param q the queue
+ * @param out where to save the removed event
+ * @return 0 on success, -1 if the queue is empty
+ */
+int eventq_pop(eventq_t* q, event_t* out);
+
+#endif // EVENTQ_H
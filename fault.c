@@ -0,0 +1,132 @@
+/* Purpose: Configurable delays and yields at the threaded bridge's
+ * lock and signal points
+ */
+
+#define _POSIX_C_SOURCE 200809L // for nanosleep()
+
+#include <stdio.h>
+#include <string.h>    // for strchr()
+#include <sched.h>     // for sched_yield()
+#include <time.h>      // for nanosleep()
+#include <stdatomic.h> // for atomic_fetch_add()
+#include "fault.h"
+#include "rng.h"
+
+#define SPEC_LEN 256
+
+/*************************** GLOBALS **************************/
+
+int fault_armed = 0;
+static fault_t faults[NUM_FAULT_POINTS];
+static uint64_t fault_seed;
+static atomic_long fired;
+static atomic_long next_thread; // numbers threads for their random streams
+
+static _Thread_local rng_t thread_rng;
+static _Thread_local int thread_seeded;
+
+static const char* point_names[NUM_FAULT_POINTS] = { "lock", "wake", "signal" };
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Parses one POINT=ACTION[:PROBABILITY[:MAX DELAY]] item
+ *
+ * @param item the item, not containing commas
+ * @return 0 on success, -1 on an invalid item
+ */
+static int parse_item(char* item) {
+  char* eq = strchr(item, '=');
+  int point;
+  if (eq == NULL)
+    return -1;
+  *eq = '\0';
+  for (point = 0; point < NUM_FAULT_POINTS; point++) {
+    if (strcmp(item, point_names[point]) == 0)
+      break;
+  }
+  if (point == NUM_FAULT_POINTS)
+    return -1;
+
+  fault_t f = { FAULT_NONE, 0.5, 100 };
+  char* action = eq + 1;
+  char* prob = strchr(action, ':');
+  char* max = NULL;
+  if (prob) {
+    *prob++ = '\0';
+    if ((max = strchr(prob, ':')) != NULL)
+      *max++ = '\0';
+    if (sscanf(prob, "%lf", &f.probability) != 1 || f.probability < 0 || f.probability > 1)
+      return -1;
+  }
+  if (max && (parse_duration(max, &f.max) || f.max < 0))
+    return -1;
+
+  if (strcmp(action, "none") == 0)
+    f.action = FAULT_NONE;
+  else if (strcmp(action, "yield") == 0)
+    f.action = FAULT_YIELD;
+  else if (strcmp(action, "delay") == 0)
+    f.action = FAULT_DELAY;
+  else
+    return -1;
+  faults[point] = f;
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int fault_configure(const char* spec, uint64_t seed) {
+  char buf[SPEC_LEN];
+  char* item;
+  int i;
+
+  if (strlen(spec) >= sizeof(buf))
+    goto invalid;
+  strcpy(buf, spec);
+  memset(faults, 0, sizeof(faults));
+  for (item = buf; item != NULL; ) {
+    char* comma = strchr(item, ',');
+    if (comma)
+      *comma++ = '\0';
+    if (*item != '\0' && parse_item(item))
+      goto invalid;
+    item = comma;
+  }
+
+  fault_seed = seed;
+  fault_armed = 0;
+  for (i = 0; i < NUM_FAULT_POINTS; i++) {
+    if (faults[i].action != FAULT_NONE && faults[i].probability > 0)
+      fault_armed = 1;
+  }
+  return 0;
+
+ invalid:
+  fprintf(stderr, "Error, invalid fault specification '%s'\n", spec);
+  return -1;
+}
+
+long fault_count(void) {
+  return atomic_load(&fired);
+}
+
+void fault_hit(int point) {
+  const fault_t* f = &faults[point];
+  if (f->action == FAULT_NONE)
+    return;
+  if (!thread_seeded) {
+    rng_seed(&thread_rng, fault_seed + 0x9e3779b97f4a7c15ULL * atomic_fetch_add(&next_thread, 1));
+    thread_seeded = 1;
+  }
+  if (rng_uniform(&thread_rng) >= f->probability)
+    return;
+
+  atomic_fetch_add(&fired, 1);
+  if (f->action == FAULT_YIELD)
+    sched_yield();
+  else {
+    sim_time_t usec = rng_range(&thread_rng, 0, f->max);
+    struct timespec ts = { usec / 1000000, (usec % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+  }
+}
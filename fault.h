@@ -0,0 +1,73 @@
+/* Purpose: Fault injection for the threaded bridge. arrive_bridge() and
+ * exit_bridge() mark the points where timing matters with FAULT_POINT():
+ * just after the bridge lock is acquired, when a condition wait returns,
+ * and before waiting cars are signalled. A configured point delays or
+ * yields the calling thread with some probability, holding whatever locks
+ * it holds, so races that need an unlucky interleaving show up in
+ * thousands of runs instead of millions.
+ *
+ * When nothing is configured a point costs one predictable branch on a
+ * global flag; building with -DLEDYARD_NO_FAULTS removes the points
+ * entirely.
+ */
+
+#ifndef FAULT_H
+#define FAULT_H
+
+#include "scenario.h" // for sim_time_t
+
+// injection points
+#define FAULT_LOCK 0   // after the bridge lock is acquired
+#define FAULT_WAKE 1   // after a condition variable wait returns
+#define FAULT_SIGNAL 2 // before a waiting car is signalled
+#define NUM_FAULT_POINTS 3
+
+// what a point does when it fires
+#define FAULT_NONE 0
+#define FAULT_YIELD 1  // sched_yield()
+#define FAULT_DELAY 2  // sleep for a uniform time up to the point's maximum
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for the fault configured at one point
+typedef struct fault {
+  int action;         // FAULT_NONE, FAULT_YIELD or FAULT_DELAY
+  double probability; // chance of firing each time the point is reached
+  sim_time_t max;     // longest delay, in real microseconds
+} fault_t;
+
+/*************************** GLOBALS **************************/
+
+extern int fault_armed; // nonzero once any point is configured
+
+/*************************** FUNCTIONS **************************/
+
+/* Configures fault points from a specification such as
+ * "lock=delay:0.3:0.2ms,wake=yield:0.5", each point being
+ * POINT=ACTION[:PROBABILITY[:MAX DELAY]] with POINT one of lock, wake or
+ * signal and ACTION one of none, yield or delay. Probability defaults to
+ * 0.5 and the longest delay to 0.1ms
+ *
+ * @param spec the specification
+ * @param seed seeds each thread's random choices of when to fire
+ * @return 0 on success, -1 on an invalid specification
+ */
+int fault_configure(const char* spec, uint64_t seed);
+
+/* Returns how many times configured points have fired so far */
+long fault_count(void);
+
+/* Fires the fault configured at a point, maybe; called by FAULT_POINT() */
+void fault_hit(int point);
+
+#ifdef LEDYARD_NO_FAULTS
+#define FAULT_POINT(point) ((void) 0)
+#else
+#define FAULT_POINT(point)				\
+  do {							\
+    if (__builtin_expect(fault_armed, 0))		\
+      fault_hit(point);					\
+  } while (0)
+#endif
+
+#endif // FAULT_H
@@ -0,0 +1,149 @@
+/* Purpose: Per-hour metrics with a fixed wait histogram per hour */
+
+#include <stdio.h>
+#include <stdlib.h> // for realloc()
+#include <string.h> // for memset()
+#include "hourly.h"
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Returns the histogram bin of a wait */
+static int wait_bin(sim_time_t wait) {
+  int64_t sec = wait / SIM_SEC;
+  if (sec < HOURLY_FINE_BINS)
+    return (int) sec;
+  sec = (sec - HOURLY_FINE_BINS) / 10;
+  return sec < HOURLY_COARSE_BINS ? HOURLY_FINE_BINS + (int) sec : HOURLY_BINS - 1;
+}
+
+/* Returns the upper edge of a histogram bin, in seconds */
+static double bin_upper(int bin) {
+  if (bin < HOURLY_FINE_BINS)
+    return bin + 1;
+  return HOURLY_FINE_BINS + 10.0 * (bin - HOURLY_FINE_BINS + 1);
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+void hourly_init(hourly_t* h) {
+  memset(h, 0, sizeof(*h));
+}
+
+void hourly_destroy(hourly_t* h) {
+  free(h->hours);
+  h->hours = NULL;
+  h->num_hours = 0;
+  h->cap = 0;
+}
+
+hour_t* hourly_at(hourly_t* h, sim_time_t now) {
+  int index = (int) (now / SIM_HOUR);
+  if (index < h->num_hours)
+    return &h->hours[index];
+
+  if (index >= h->cap) {
+    int grown_cap = index + 1 > 2 * h->cap ? index + 1 : 2 * h->cap;
+    hour_t* grown = (hour_t*) realloc(h->hours, grown_cap * sizeof(hour_t));
+    if (grown == NULL) {
+      fprintf(stderr, "Error growing hourly metrics\n");
+      return NULL;
+    }
+    h->hours = grown;
+    h->cap = grown_cap;
+  }
+  // new hours start with whatever queue the previous one ended with
+  for (; h->num_hours <= index; h->num_hours++) {
+    memset(&h->hours[h->num_hours], 0, sizeof(hour_t));
+    h->hours[h->num_hours].max_queue = h->queued;
+  }
+  return &h->hours[index];
+}
+
+int hourly_arrive(hourly_t* h, sim_time_t now, int queued) {
+  hour_t* hour = hourly_at(h, now);
+  if (hour == NULL)
+    return -1;
+  hour->arrived++;
+  h->queued = queued;
+  if (queued > hour->max_queue)
+    hour->max_queue = queued;
+  return 0;
+}
+
+int hourly_board(hourly_t* h, sim_time_t now, sim_time_t wait, int queued) {
+  hour_t* hour = hourly_at(h, now);
+  if (hour == NULL)
+    return -1;
+  hour->boarded++;
+  hour->wait_sum += (double) wait / SIM_SEC;
+  if (wait > hour->wait_max)
+    hour->wait_max = wait;
+  hour->hist[wait_bin(wait)]++;
+  h->queued = queued;
+  return 0;
+}
+
+int hourly_balk(hourly_t* h, sim_time_t now) {
+  hour_t* hour = hourly_at(h, now);
+  if (hour == NULL)
+    return -1;
+  hour->balked++;
+  return 0;
+}
+
+int hourly_renege(hourly_t* h, sim_time_t now, int queued) {
+  hour_t* hour = hourly_at(h, now);
+  if (hour == NULL)
+    return -1;
+  hour->reneged++;
+  h->queued = queued;
+  return 0;
+}
+
+int hourly_exit(hourly_t* h, sim_time_t now) {
+  hour_t* hour = hourly_at(h, now);
+  if (hour == NULL)
+    return -1;
+  hour->crossed++;
+  return 0;
+}
+
+int hourly_switch(hourly_t* h, sim_time_t now) {
+  hour_t* hour = hourly_at(h, now);
+  if (hour == NULL)
+    return -1;
+  hour->switches++;
+  return 0;
+}
+
+double hourly_p95(const hour_t* hour) {
+  uint64_t seen = 0;
+  int bin;
+  if (hour->boarded == 0)
+    return 0.0;
+  // the smallest bin holding the ceil(0.95 n)-th wait
+  uint64_t rank = (hour->boarded * 95 + 99) / 100;
+  for (bin = 0; bin < HOURLY_BINS; bin++) {
+    seen += hour->hist[bin];
+    if (seen >= rank)
+      break;
+  }
+  double upper = bin_upper(bin);
+  double max = (double) hour->wait_max / SIM_SEC;
+  return bin == HOURLY_BINS - 1 || upper > max ? max : upper;
+}
+
+void hourly_print(FILE* fp, const hourly_t* h) {
+  int i;
+  fprintf(fp, "\n%-11s %8s %8s %10s %10s %9s %8s %7s %7s\n", "hour", "arrived", "crossed",
+	  "mean wait", "p95 wait", "max queue", "switches", "balked", "reneged");
+  for (i = 0; i < h->num_hours; i++) {
+    const hour_t* hour = &h->hours[i];
+    fprintf(fp, "d%d %02d-%02d:00 %8llu %8llu %9.1fs %9.1fs %9d %8llu %7llu %7llu\n", i / 24 + 1,
+	    i % 24, i % 24 + 1, (unsigned long long) hour->arrived,
+	    (unsigned long long) hour->crossed,
+	    hour->boarded ? hour->wait_sum / hour->boarded : 0.0, hourly_p95(hour),
+	    hour->max_queue, (unsigned long long) hour->switches,
+	    (unsigned long long) hour->balked, (unsigned long long) hour->reneged);
+  }
+}
@@ -0,0 +1,106 @@
+/* Purpose: Per-hour results of a run (throughput, mean and 95th
+ * percentile wait, longest queue, direction switches, impatient drivers),
+ * kept up to date as cars arrive, board and exit so that a full-day run
+ * prints its hourly profile without a trace to post-process.
+ *
+ * Each hour keeps a fixed histogram of waits: one-second bins up to ten
+ * minutes, then ten-second bins up to 110 minutes, then one overflow bin.
+ * The 95th percentile is read from it at the end, accurate to its bin.
+ */
+
+#ifndef HOURLY_H
+#define HOURLY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "scenario.h"
+
+#define HOURLY_FINE_BINS 600   // one-second bins, waits under 10 minutes
+#define HOURLY_COARSE_BINS 600 // ten-second bins, waits under 110 minutes
+#define HOURLY_BINS (HOURLY_FINE_BINS + HOURLY_COARSE_BINS + 1) // plus overflow
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one simulated hour of metrics
+typedef struct hour {
+  uint64_t arrived;   // cars that joined the lobby during the hour
+  uint64_t boarded;   // cars that got on the bridge during the hour
+  uint64_t crossed;   // cars that exited during the hour
+  uint64_t balked;    // drivers who turned back on arriving
+  uint64_t reneged;   // drivers who gave up waiting and left the lobby
+  double wait_sum;    // sum of the boarded cars' waits, in seconds
+  sim_time_t wait_max; // longest of those waits
+  int max_queue;      // most cars waiting at once during the hour
+  uint64_t switches;  // times the direction of traffic flipped
+  uint32_t hist[HOURLY_BINS]; // the boarded cars' waits
+} hour_t;
+
+// define a data structure for the hourly metrics of one run
+typedef struct hourly {
+  hour_t* hours;  // hour h covers [h, h + 1) hours of simulated time
+  int num_hours;  // hours reached so far
+  int cap;        // hours allocated
+  int queued;     // cars waiting right now, carried into new hours
+} hourly_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Initializes empty hourly metrics */
+void hourly_init(hourly_t* h);
+
+/* Frees hourly metrics */
+void hourly_destroy(hourly_t* h);
+
+/* Returns the hour holding time now, adding hours as the run goes on
+ *
+ * @return the hour, or NULL on allocation error
+ */
+hour_t* hourly_at(hourly_t* h, sim_time_t now);
+
+/* Records a car joining the lobby, which then holds queued cars
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+int hourly_arrive(hourly_t* h, sim_time_t now, int queued);
+
+/* Records a car getting on the bridge after waiting for wait, leaving
+ * queued cars in the lobby
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+int hourly_board(hourly_t* h, sim_time_t now, sim_time_t wait, int queued);
+
+/* Records a driver turning back on arriving, without joining the lobby
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+int hourly_balk(hourly_t* h, sim_time_t now);
+
+/* Records a driver giving up and leaving the lobby, which then holds
+ * queued cars
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+int hourly_renege(hourly_t* h, sim_time_t now, int queued);
+
+/* Records a car exiting the bridge
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+int hourly_exit(hourly_t* h, sim_time_t now);
+
+/* Records the direction of traffic flipping
+ *
+ * @return 0 on success, -1 on allocation error
+ */
+int hourly_switch(hourly_t* h, sim_time_t now);
+
+/* Returns the 95th percentile wait of an hour in seconds, or 0 if no car
+ * boarded in it
+ */
+double hourly_p95(const hour_t* hour);
+
+/* Prints one line per hour of the run */
+void hourly_print(FILE* fp, const hourly_t* h);
+
+#endif // HOURLY_H
@@ -5,20 +5,52 @@
  * utilizing multiple threads, each representing a car approaching the bridge
  */
 
+#define _POSIX_C_SOURCE 200809L // for clock_gettime(), clock_nanosleep()
+
 #include <pthread.h>
 #include <stdio.h>  // for printf
 #include <unistd.h> // for sleep()
 #include <stdlib.h> // for rand()
 #include <sys/time.h> // for time of day random seeding
+#include <time.h>   // for clock_gettime()
 #include <limits.h> // for UINT_MAX
 #include <string.h> // for strlen()
 #include <ctype.h> // for isspace()
+#include <math.h>  // for fabs()
+#include <errno.h> // for EINTR
+#include <dirent.h> // for opendir()
+#include <signal.h> // for sigaction()
+#include <stdatomic.h> // for atomic_fetch_add()
+#include <semaphore.h> // for sem_wait()
+#include <sched.h>  // for sched_yield()
+#include "scenario.h" // for MAX_CARS, directions and scenario settings
+#include "des.h"    // for the discrete-event engine
+#include "outbuf.h" // for buffered bridge messages
+#include "trace.h"  // for decoding traces
+#include "analytic.h" // for screening scenarios
+#include "rare.h"   // for estimating rare long waits
+#include "sens.h"   // for sensitivity analysis
+#include "procpool.h" // for runs in worker processes
+#include "diff.h"   // for checking replays against the discrete-event engine
+#include "fault.h"  // for injecting delays at lock and signal points
+#include "route.h"  // for route choice against a lock-free snapshot
+#include "rng.h"    // for replayed drivers' route choices
+#include "mpsc.h"   // for the bridge controller's request queue
+#include "server.h" // for the long-lived simulation server
+#include "statpage.h" // for the status page read by monitors
+#include "arrow.h"  // for exporting traces and results as Arrow tables
 
-#define MAX_CARS 3      // maximum number of cars on Ledyard at a time
-#define NO_DIRECTION -1 
-#define TO_HANOVER 0
-#define TO_NORWICH 1
 #define STR_LEN 10
+#define DIFF_SCALE 0.001    // default real seconds per simulated second in diff mode
+#define STRESS_SCALE 0.00001 // and in stress mode, so many cars contend
+#define BENCH_SCALE 0.0000001 // and in bench mode on a threaded bridge, so
+                              // the locks rather than the sleeps dominate
+#define STRESS_FAULTS "lock=delay:0.2:0.05ms,wake=yield:0.5,signal=delay:0.2:0.05ms"
+
+// requests to the bridge controller
+#define REQ_ARRIVE 0
+#define REQ_EXIT 1
+#define REQ_STOP 2
 
 /*************************** DATA STRUCTURES **************************/
 
@@ -32,8 +64,37 @@ typedef struct bridge_state {
   pthread_mutex_t lock; // Mutex Lock for reading/writing bridge_state
   pthread_cond_t want_to_hanover; // Cond Var for cars going to Hanover
   pthread_cond_t want_to_norwich; // Cond Var for cars going to Norwich
+  outbuf_t out;     // buffered bridge messages; only written holding lock
+  const script_car_t* script; // the cars being replayed, if any
+  trace_record_t* log; // when replaying a script, events instead of
+                    // messages: each car's shard of 3 starts at 3 * its id
+  size_t* log_len;  // events in each car's shard
+  atomic_ullong next_seq; // events logged so far, numbering them in the
+                    // order the locks let them happen
+  struct timespec start; // when the replay began
+  double scale;     // real seconds per simulated second in a replay
+  const scenario_t* routes; // route choice settings in a replay, or NULL
+  route_snapshot_t snapshot; // lobby sizes for route choice, published
+                    // holding lock and read without it
+  statpage_t* status; // the status page for monitors, or NULL
+  atomic_long detoured; // cars that took the detour in a replay
+  const scenario_t* drivers; // balking and patience settings in a replay,
+                    // or NULL; only the mutex bridge honours them
+  atomic_long balked;   // cars whose drivers turned back in a replay
+  atomic_long reneged;  // cars whose drivers gave up waiting in a replay
 } bridge_state_t;
 
+struct car;
+
+// define a data structure for a request to the thread applying cars'
+// operations, in the actor and combining architectures
+typedef struct bridge_req {
+  mpsc_node_t node;       // link in the pending requests; must be first
+  int op;                 // REQ_ARRIVE, REQ_EXIT or REQ_STOP
+  struct car* car;        // the requesting car, NULL for REQ_STOP
+  atomic_int applied;     // set once the request has been applied
+} bridge_req_t;
+
 // define a data structue for the car
 // and all the bridge variable addresses it will eventually write to
 // the ptrs are helpful for identifying which variables in bridge to edit
@@ -45,11 +106,99 @@ typedef struct car {
   int* wait_other_dir;    // ptr to bridge's 'wait_town' in other dir
   pthread_cond_t* current;// ptr to the applicable cond var in bridge for this car's direction
   pthread_cond_t* other;  // ptr to the other cond var
+  uint64_t id;            // the car's index in a replayed script
+  sim_time_t boarded;     // when the car got on the bridge in a replay
+  sim_time_t arrived;     // when the car joined its lobby, for the status page
+  sim_time_t give_up;     // when the driver stops waiting in a replay
+                          // (0 = never)
+  bridge_req_t req;       // the car's request to the bridge controller
+                          // or combiner
+  sem_t answered;         // posted once req is done: the car is on or off
+  struct car* next;       // next car in the same lobby
 } car_t;
 
+// define a data structure for one way of running the bridge's operations
+// on replayed cars
+typedef struct bridge_ops {
+  const char* name;
+  int (*start)(void);         // starts any helper thread, or NULL
+  int (*stop)(void);          // stops it once every car is done, or NULL
+  int (*arrive)(car_t* car);  // returns once the car is on the bridge
+  int (*exit)(car_t* car);    // returns once the car is off the bridge
+} bridge_ops_t;
+
+// define a data structure for the FIFO lobbies kept by whichever thread
+// applies requests in the actor and combining architectures
+typedef struct lobbies {
+  car_t* head[NUM_DIRECTIONS]; // first car waiting towards each town
+  car_t* tail[NUM_DIRECTIONS]; // last car waiting towards each town
+  int last_dir;           // direction of the last traffic flow
+} lobbies_t;
+
+// define a data structure for the bridge controller, the one thread that
+// owns the bridge state in the actor architecture
+typedef struct actor {
+  pthread_t thread;
+  mpsc_t requests;        // requests from cars, in the order they were made
+  sem_t wake;             // posted after every request
+} actor_t;
+
+// define a data structure for the combining architecture, in which the
+// car holding the combiner lock applies every published request
+typedef struct combiner {
+  pthread_mutex_t lock;   // held by the car applying requests
+  _Atomic(mpsc_node_t*) pending; // published requests, newest first
+} combiner_t;
+
+// define a data structure for the split architecture: each direction has
+// its own lock, condition variable and counts, and only flipping the
+// direction of traffic takes the global flip lock
+typedef struct split {
+  pthread_mutex_t lock[NUM_DIRECTIONS]; // guards each direction's counts
+  pthread_cond_t cond[NUM_DIRECTIONS];  // cars waiting towards each town
+  atomic_int waiting[NUM_DIRECTIONS];   // written holding lock[d]
+  atomic_int on[NUM_DIRECTIONS];        // cars on the bridge, written holding lock[d]
+  atomic_int dir;         // direction of traffic, written holding flip and lock[dir]
+  pthread_mutex_t flip;   // taken after lock[d] to change dir
+  pthread_mutex_t note;   // orders route snapshots and status page updates
+} split_t;
+
 /********************* GLOBALS *******************/
 
 static bridge_state_t ledyard; // global variable for the ledyard bridge state
+static lobbies_t lobbies;      // cars waiting, in the actor and combining
+                               // architectures
+static actor_t actor;          // the bridge controller, while one runs
+static combiner_t combiner;    // the combining architecture's requests
+static split_t split;          // the split architecture's locks and counts
+static const bridge_ops_t* bridge_ops; // how replayed cars use the bridge
+
+// define a data structure for command line options that are not part of
+// the simulated scenario
+typedef struct cli {
+  char mode[STR_LEN];   // what to do with the scenario, see run_cli()
+  double sweep_lo;      // first total arrival rate of a sweep, cars/min
+  double sweep_hi;      // last total arrival rate of a sweep, cars/min
+  int sweep_steps;      // number of rates in a sweep (0 = no sweep given)
+  double max_util;      // sweep points predicted above this are skipped
+  rare_opts_t rare;     // how to estimate rare long waits
+  sens_opts_t sens;     // factor ranges and design size of a sensitivity analysis
+  double time_scale;    // real seconds per simulated second when replaying
+                        // (0 = the mode's default)
+  double alpha;         // significance level of differential tests
+  char golden[PATH_LEN]; // directory of golden scenarios and traces
+  int update;           // nonzero to rewrite golden traces instead of checking
+  char faults[PATH_LEN]; // fault injection specification, see fault.h
+  int rounds;           // replays in a stress test
+  int repeat;           // timed runs per benchmark scenario
+  char bench_dir[PATH_LEN]; // directory of scenarios to benchmark ("" for the command line's)
+  char arch[STR_LEN];   // how replayed cars use the bridge, see archs
+  char socket[PATH_LEN]; // UNIX socket the server listens on ("" for stdin)
+  char status[PATH_LEN]; // status page replays publish and monitors read
+  char shards[PATH_LEN]; // directory of trace shards to merge
+  char results[PATH_LEN]; // Arrow file of one row per simulated run ("" for none)
+  sim_time_t watch;     // how often a monitor rereads the page (0 = once)
+} cli_t;
 
 /********************** HELPER FUNCTIONS ********************/
 
@@ -85,6 +234,147 @@ static int min(int a, int b) {
   return a < b ? a : b;
 }
 
+/* Returns the simulated time of a replay, scaling the real time since
+ * it began; outside replays, the real time since the bridge was
+ * initialized
+ */
+static sim_time_t replay_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double real_usec = (now.tv_sec - ledyard.start.tv_sec) * 1e6 +
+    (now.tv_nsec - ledyard.start.tv_nsec) / 1e3;
+  return (sim_time_t) (real_usec / ledyard.scale);
+}
+
+/* Converts a replay's simulated time to the monotonic clock
+ *
+ * @param t the simulated time
+ * @param when where to save the real time it is reached at
+ */
+static void replay_deadline(sim_time_t t, struct timespec* when) {
+  double real_nsec = (double) t * ledyard.scale * 1e3;
+  *when = ledyard.start;
+  long long nsec = when->tv_nsec + (long long) real_nsec;
+  when->tv_sec += nsec / 1000000000LL;
+  when->tv_nsec = nsec % 1000000000LL;
+}
+
+/* Sleeps until a replay reaches a simulated time
+ *
+ * @param t the simulated time to wake at
+ */
+static void replay_sleep_until(sim_time_t t) {
+  struct timespec when;
+  replay_deadline(t, &when);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR)
+    ;
+}
+
+/* Records one of a replayed car's events in the car's own shard of the
+ * log. Only the thread acting for the car at the time calls this, holding
+ * the lock that orders the event, so shards need no lock of their own and
+ * the timestamps of dependent events increase; replay_script() merges the
+ * shards by time into the order the events changed the bridge state.
+ * Timestamps are truncated to a simulated microsecond, so at a coarse
+ * time scale an exit and the boarding it allowed can share one; the
+ * sequence number taken under the same lock keeps them in order
+ *
+ * @param car the car
+ * @param type TRACE_ARRIVE, TRACE_BOARD or TRACE_EXIT
+ */
+static void replay_record(car_t* car, int type) {
+  trace_record_t* rec = &ledyard.log[3 * car->id + ledyard.log_len[car->id]++];
+  rec->time = replay_now();
+  rec->seq = atomic_fetch_add(&ledyard.next_seq, 1) + 1;
+  rec->car = car->id;
+  rec->type = type;
+  rec->dir = car->dir;
+  if (type == TRACE_BOARD)
+    car->boarded = rec->time;
+}
+
+/* Publishes the lobby sizes for route choice. The caller must hold the
+ * bridge's lock, so that only one thread publishes at a time
+ */
+static void publish_waiting(void) {
+  int waiting[NUM_DIRECTIONS];
+  waiting[TO_HANOVER] = ledyard.wait_hanover;
+  waiting[TO_NORWICH] = ledyard.wait_norwich;
+  route_publish(&ledyard.snapshot, waiting);
+}
+
+/* Publishes a car's event and the given bridge state on the status page.
+ * Only one thread may call this at a time
+ *
+ * @param car the car
+ * @param type TRACE_ARRIVE, TRACE_BOARD or TRACE_EXIT
+ * @param dir the direction of traffic
+ * @param num_cars the cars on the bridge
+ * @param waiting the cars waiting towards each town
+ */
+static void note_status(car_t* car, int type, int dir, int num_cars,
+			const int waiting[NUM_DIRECTIONS]) {
+  sim_time_t now = replay_now();
+  if (type == TRACE_ARRIVE)
+    car->arrived = now;
+  statpage_update(ledyard.status, dir, num_cars, waiting, type, car->dir, now - car->arrived, now);
+}
+
+/* Publishes a car's event on the status page. The caller must hold the
+ * bridge's lock, or be the thread applying requests
+ */
+static void publish_status(car_t* car, int type) {
+  int waiting[NUM_DIRECTIONS];
+  waiting[TO_HANOVER] = ledyard.wait_hanover;
+  waiting[TO_NORWICH] = ledyard.wait_norwich;
+  note_status(car, type, ledyard.dir, ledyard.num_cars, waiting);
+}
+
+/* Decides whether a replayed car takes the detour, from the published
+ * lobby sizes and without taking the bridge's lock. Each car's draw
+ * depends only on the seed and its id, so a replay repeats its choices
+ * as far as the snapshot it sees repeats
+ *
+ * @param car the arriving car
+ * @return nonzero to take the detour
+ */
+static int choose_detour(const car_t* car) {
+  int waiting[NUM_DIRECTIONS];
+  rng_t rng;
+  route_read(&ledyard.snapshot, waiting);
+  rng_seed(&rng, ledyard.routes->seed ^ (car->id + 1) * 0x9e3779b97f4a7c15ULL);
+  return route_detour(ledyard.routes, waiting[car->dir], rng_uniform(&rng));
+}
+
+/* Draws how long a replayed car's driver waits before giving up. Like
+ * route choices, the draw depends only on the seed and the car's id
+ *
+ * @param car the arriving car
+ * @return the driver's patience, exponentially distributed
+ */
+static sim_time_t draw_patience(const car_t* car) {
+  rng_t rng;
+  rng_seed(&rng, ledyard.drivers->seed ^ (car->id + 1) * 0xbf58476d1ce4e5b9ULL);
+  return (sim_time_t) rng_exponential(&rng, (double) ledyard.drivers->patience);
+}
+
+/* Takes a car whose driver gave up out of its lobby. Admission to the
+ * bridge depends only on the direction of traffic and the cars on it, so
+ * leaving unblocks no other car and signals none; exit_bridge() sizes its
+ * signals by the waiting counts, which no longer include this car. The
+ * caller must hold the bridge's lock
+ *
+ * @param car the car
+ */
+static void leave_lobby(car_t* car) {
+  (*car->wait_dir)--;
+  if (ledyard.routes)
+    publish_waiting();
+  if (ledyard.status)
+    publish_status(car, STATPAGE_COUNTS);
+  atomic_fetch_add(&ledyard.reneged, 1);
+}
+
 /* must declare fileno() */
 int fileno(FILE *stream);
 
@@ -174,6 +464,7 @@ static int initialize_car(car_t* car, int dir) {
     fprintf(stderr, "Arriving car has no intended direction\n");
     return -1;
   }
+  car->give_up = 0; // drivers wait as long as it takes
   
   return 0;
 }
@@ -187,28 +478,71 @@ static int initialize_car(car_t* car, int dir) {
  * If not, car waits for a signal when these conditions are made 
  * true before getting on the bridge (of course Mesa-style)
  *
+ * In a replay with impatient drivers, a driver turns back at once if
+ * ledyard.drivers->balk_queue cars already wait its way, and gives up
+ * waiting at car->give_up
+ *
  * This function is a critical section, and thus utilizes 
  * the bridge's mutex over the entire function. It will release
  * when it is waiting for favorable conditions stated below.
  *
  * @param car a pointer to the arriving car 
- * @return 0 on success, -1 on mutex error or flawed invariant
+ * @return 0 on success, 1 if the driver balked or gave up, -1 on mutex
+ *         error or flawed invariant
  */
 static int arrive_bridge(car_t* car) {  
+  struct timespec give_up;
+  int rc;
+
   if (pthread_mutex_lock(&ledyard.lock)) {
     fprintf(stderr, "Error acquiring lock for arrive_bridge()");
     return -1;
   }
+  FAULT_POINT(FAULT_LOCK);
   /************** Waiting Lobby ****************/
+  if (ledyard.drivers && ledyard.drivers->balk_queue > 0 &&
+      *car->wait_dir >= ledyard.drivers->balk_queue) {
+    atomic_fetch_add(&ledyard.balked, 1);
+    if (pthread_mutex_unlock(&ledyard.lock)) {
+      fprintf(stderr, "Error releasing lock for arrive_bridge()\n");
+      return -1;
+    }
+    return 1;
+  }
   (*car->wait_dir)++;    // add car to waiting lobby
-  printf("A new car is waiting to go to %s\n", car->str_dir);
+  if (ledyard.routes)
+    publish_waiting();
+  if (ledyard.log)
+    replay_record(car, TRACE_ARRIVE);
+  else
+    outbuf_arrive(&ledyard.out, car->dir);
+  if (ledyard.status)
+    publish_status(car, TRACE_ARRIVE);
 
-  // wait until conditions are true
+  // wait until conditions are true, or the driver's patience runs out
+  if (car->give_up)
+    replay_deadline(car->give_up, &give_up);
   while (ledyard.dir == car->other_dir || ledyard.num_cars >= MAX_CARS) {
-    if (pthread_cond_wait(car->current, &ledyard.lock)) {
+    rc = car->give_up ? pthread_cond_timedwait(car->current, &ledyard.lock, &give_up) :
+      pthread_cond_wait(car->current, &ledyard.lock);
+    if (rc == ETIMEDOUT) {
+      // a wait that timed out may still have taken a signal; if the car
+      // can board it uses the signal itself, and if not, the signal was
+      // of no use to any car its way either
+      if (ledyard.dir != car->other_dir && ledyard.num_cars < MAX_CARS)
+	break;
+      leave_lobby(car);
+      if (pthread_mutex_unlock(&ledyard.lock)) {
+	fprintf(stderr, "Error releasing lock for arrive_bridge()\n");
+	return -1;
+      }
+      return 1;
+    }
+    if (rc) {
       fprintf(stderr, "Error blocking thread on a condition variable\n");
       return -1;
     }
+    FAULT_POINT(FAULT_WAKE);
   }
   
   /**************** Getting on the Bridge **************/    
@@ -234,9 +568,16 @@ static int arrive_bridge(car_t* car) {
     strcpy(ledyard.str_dir, car->str_dir);
   }
   (*car->wait_dir)--;    // remove car from waiting lobby
+  if (ledyard.routes)
+    publish_waiting();
   ledyard.num_cars++;    // add car to bridge
 
-  printf("+++ A car got on bridge to %s +++\n", car->str_dir);
+  if (ledyard.log)
+    replay_record(car, TRACE_BOARD);
+  else
+    outbuf_board(&ledyard.out, car->dir);
+  if (ledyard.status)
+    publish_status(car, TRACE_BOARD);
 
   if (pthread_mutex_unlock(&ledyard.lock)) {
     fprintf(stderr, "Error releasing lock for arrive_bridge()\n");
@@ -262,10 +603,8 @@ static int on_bridge(car_t* car) {
     return -1;
   }
 
-  printf("\n====== Ledyard Bridge ======\n");
-  printf("Flow of Traffic: %d cars to %s\n", ledyard.num_cars, ledyard.str_dir);
-  printf("Cars waiting for Hanover: %d\n", ledyard.wait_hanover);
-  printf("Cars waiting for Norwich: %d\n\n", ledyard.wait_norwich);
+  outbuf_bridge(&ledyard.out, ledyard.num_cars, ledyard.str_dir,
+		ledyard.wait_hanover, ledyard.wait_norwich);
 
   if (pthread_mutex_unlock(&ledyard.lock)) {
     fprintf(stderr, "Error releasing lock for on_bridge()\n");
@@ -293,6 +632,7 @@ static int exit_bridge(car_t* car) {
     fprintf(stderr, "Error acquiring lock for exit_bridge()\n");
     return -1;
   }
+  FAULT_POINT(FAULT_LOCK);
 
   ledyard.num_cars--;   // removing car from bridge state
   // editing bridge state if no more cars on bridge
@@ -306,6 +646,7 @@ static int exit_bridge(car_t* car) {
   // signal current direction's waiting cars
   int i;
   for (i = 0; i < num_sig_current; i++) {
+    FAULT_POINT(FAULT_SIGNAL);
     if (pthread_cond_signal(car->current)) {
       fprintf(stderr, "Error signaling to unblock threads on condition variable\n");
       return -1;
@@ -315,13 +656,19 @@ static int exit_bridge(car_t* car) {
   // signal other direction's waiting cars; if ledyard.num_cars
   // was NOT 0, this loop won't run and no signal will be sent here
   for (i = 0; i < num_sig_other; i++) {
+    FAULT_POINT(FAULT_SIGNAL);
     if (pthread_cond_signal(car->other)) {
       fprintf(stderr, "Error signaling to unblcok threads on condition variable\n");
       return -1;
     }
   }
   
-  printf("--- A car has exited for %s ---\n", car->str_dir);
+  if (ledyard.log)
+    replay_record(car, TRACE_EXIT);
+  else
+    outbuf_exit(&ledyard.out, car->dir);
+  if (ledyard.status)
+    publish_status(car, TRACE_EXIT);
 
   if (pthread_mutex_unlock(&ledyard.lock)) {
     fprintf(stderr, "Error releasing lock for exit_bridge()\n");
@@ -331,6 +678,514 @@ static int exit_bridge(car_t* car) {
   return 0;
 }
 
+/* Puts the car at the head of its direction's lobby on the bridge and
+ * lets the car's thread go on. Only the thread applying requests calls
+ * this
+ *
+ * @param car the car
+ */
+static void lobby_board(car_t* car) {
+  lobbies.head[car->dir] = car->next;
+  if (lobbies.head[car->dir] == NULL)
+    lobbies.tail[car->dir] = NULL;
+  if (ledyard.dir == NO_DIRECTION) {
+    ledyard.dir = car->dir;
+    strcpy(ledyard.str_dir, car->str_dir);
+  }
+  (*car->wait_dir)--;
+  ledyard.num_cars++;
+  if (ledyard.routes)
+    publish_waiting();
+  if (ledyard.log)
+    replay_record(car, TRACE_BOARD);
+  else
+    outbuf_board(&ledyard.out, car->dir);
+  if (ledyard.status)
+    publish_status(car, TRACE_BOARD);
+  FAULT_POINT(FAULT_SIGNAL);
+  sem_post(&car->answered);
+}
+
+/* Boards every car the bridge state allows, once all the requests found
+ * have been applied. An empty bridge serves the other direction first if
+ * anyone waits there, as the discrete-event engine does
+ */
+static void lobby_admit(void) {
+  int d = ledyard.dir;
+  if (d == NO_DIRECTION) {
+    d = lobbies.last_dir == TO_HANOVER ? TO_NORWICH : TO_HANOVER;
+    if (lobbies.head[d] == NULL)
+      d = 1 - d;
+  }
+  while (lobbies.head[d] != NULL && ledyard.num_cars < MAX_CARS)
+    lobby_board(lobbies.head[d]);
+}
+
+/* Applies one car's arrive or exit request to the bridge state: an
+ * arriving car joins its lobby, an exiting car leaves the bridge and may
+ * go on. Only the thread applying requests calls this
+ *
+ * @param req the request
+ */
+static void apply_request(bridge_req_t* req) {
+  car_t* car = req->car;
+  if (req->op == REQ_ARRIVE) {
+    (*car->wait_dir)++;
+    if (ledyard.routes)
+      publish_waiting();
+    if (ledyard.log)
+      replay_record(car, TRACE_ARRIVE);
+    else
+      outbuf_arrive(&ledyard.out, car->dir);
+    if (ledyard.status)
+      publish_status(car, TRACE_ARRIVE);
+    car->next = NULL;
+    if (lobbies.tail[car->dir] == NULL)
+      lobbies.head[car->dir] = car;
+    else
+      lobbies.tail[car->dir]->next = car;
+    lobbies.tail[car->dir] = car;
+    atomic_store_explicit(&req->applied, 1, memory_order_release);
+    return;
+  }
+
+  ledyard.num_cars--;
+  if (ledyard.num_cars == 0) {
+    lobbies.last_dir = ledyard.dir;
+    ledyard.dir = NO_DIRECTION;
+    strcpy(ledyard.str_dir, "Neither");
+  }
+  if (ledyard.log)
+    replay_record(car, TRACE_EXIT);
+  else
+    outbuf_exit(&ledyard.out, car->dir);
+  if (ledyard.status)
+    publish_status(car, TRACE_EXIT);
+  atomic_store_explicit(&req->applied, 1, memory_order_release);
+  FAULT_POINT(FAULT_SIGNAL);
+  sem_post(&car->answered); // the car may be gone after this
+}
+
+/* Resets the lobbies to empty */
+static void lobbies_init(void) {
+  lobbies.head[TO_HANOVER] = lobbies.head[TO_NORWICH] = NULL;
+  lobbies.tail[TO_HANOVER] = lobbies.tail[TO_NORWICH] = NULL;
+  lobbies.last_dir = NO_DIRECTION;
+}
+
+/* Runs the bridge controller: applies every queued request to the bridge
+ * state it alone owns, then boards what it can in one pass, then sleeps
+ * until the next request
+ *
+ * @param vargp unused
+ * @return NULL once asked to stop
+ */
+static void* bridge_controller(void* vargp) {
+  (void) vargp;
+  for (;;) {
+    mpsc_node_t* node;
+    while (sem_wait(&actor.wake) && errno == EINTR)
+      ;
+    while ((node = mpsc_pop(&actor.requests)) != NULL) {
+      bridge_req_t* req = (bridge_req_t*) node;
+      if (req->op == REQ_STOP)
+	return NULL;
+      apply_request(req);
+    }
+    lobby_admit();
+  }
+}
+
+/* Sends a car's request to the bridge controller and waits for the answer
+ *
+ * @param car the car
+ * @param op REQ_ARRIVE or REQ_EXIT
+ * @return 0 on success, -1 on semaphore error
+ */
+static int actor_request(car_t* car, int op) {
+  car->req.op = op;
+  car->req.car = car;
+  atomic_store_explicit(&car->req.applied, 0, memory_order_relaxed);
+  mpsc_push(&actor.requests, &car->req.node);
+  if (sem_post(&actor.wake)) {
+    fprintf(stderr, "Error waking the bridge controller\n");
+    return -1;
+  }
+  while (sem_wait(&car->answered)) {
+    if (errno != EINTR) {
+      fprintf(stderr, "Error waiting for the bridge controller\n");
+      return -1;
+    }
+  }
+  FAULT_POINT(FAULT_WAKE);
+  return 0;
+}
+
+/* Handles a car arriving at the bridge in the actor architecture: the
+ * controller queues it and answers once it is on the bridge
+ *
+ * @param car a pointer to the arriving car
+ * @return 0 on success, -1 on semaphore error
+ */
+static int actor_arrive(car_t* car) {
+  if (sem_init(&car->answered, 0, 0)) {
+    fprintf(stderr, "Error initializing a car's semaphore\n");
+    return -1;
+  }
+  return actor_request(car, REQ_ARRIVE);
+}
+
+/* Handles a car exiting the bridge in the actor architecture; the
+ * controller answers once the car is off, so the car may then go away
+ *
+ * @param car a pointer to the exiting car
+ * @return 0 on success, -1 on semaphore error
+ */
+static int actor_exit(car_t* car) {
+  int rc = actor_request(car, REQ_EXIT);
+  sem_destroy(&car->answered);
+  return rc;
+}
+
+/* Starts the bridge controller thread with empty lobbies
+ *
+ * @return 0 on success, -1 on error
+ */
+static int actor_start(void) {
+  mpsc_init(&actor.requests);
+  lobbies_init();
+  if (sem_init(&actor.wake, 0, 0)) {
+    fprintf(stderr, "Error initializing the bridge controller's semaphore\n");
+    return -1;
+  }
+  if (pthread_create(&actor.thread, NULL, bridge_controller, NULL)) {
+    fprintf(stderr, "Error creating the bridge controller thread\n");
+    sem_destroy(&actor.wake);
+    return -1;
+  }
+  return 0;
+}
+
+/* Stops the bridge controller once every car is done with the bridge
+ *
+ * @return 0 on success, -1 on error
+ */
+static int actor_stop(void) {
+  bridge_req_t stop = { .op = REQ_STOP, .car = NULL };
+  int rc = 0;
+  mpsc_push(&actor.requests, &stop.node);
+  if (sem_post(&actor.wake) || pthread_join(actor.thread, NULL)) {
+    fprintf(stderr, "Error stopping the bridge controller\n");
+    rc = -1;
+  }
+  sem_destroy(&actor.wake);
+  return rc;
+}
+
+/* Applies every published request in the order it was published, then
+ * boards what it can in one pass. The caller must hold the combiner lock
+ */
+static void combine(void) {
+  mpsc_node_t* node = atomic_exchange_explicit(&combiner.pending, NULL, memory_order_acquire);
+  mpsc_node_t* fifo = NULL;
+
+  // the requests were pushed newest first
+  while (node != NULL) {
+    mpsc_node_t* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+    atomic_store_explicit(&node->next, fifo, memory_order_relaxed);
+    fifo = node;
+    node = next;
+  }
+  while (fifo != NULL) {
+    mpsc_node_t* next = atomic_load_explicit(&fifo->next, memory_order_relaxed);
+    apply_request((bridge_req_t*) fifo); // fifo may be gone after this
+    fifo = next;
+  }
+  lobby_admit();
+}
+
+/* Publishes a car's request for the combiner and waits until it is done.
+ * While the request is pending, the car takes the combiner lock if it is
+ * free and applies everyone's requests itself; once it is applied, an
+ * arriving car sleeps until some combiner boards it
+ *
+ * @param car the car
+ * @param op REQ_ARRIVE or REQ_EXIT
+ * @return 0 on success, -1 on lock or semaphore error
+ */
+static int combining_request(car_t* car, int op) {
+  mpsc_node_t* head = atomic_load_explicit(&combiner.pending, memory_order_relaxed);
+  car->req.op = op;
+  car->req.car = car;
+  atomic_store_explicit(&car->req.applied, 0, memory_order_relaxed);
+  do {
+    atomic_store_explicit(&car->req.node.next, head, memory_order_relaxed);
+  } while (!atomic_compare_exchange_weak_explicit(&combiner.pending, &head, &car->req.node,
+						  memory_order_release, memory_order_relaxed));
+
+  while (sem_trywait(&car->answered)) {
+    if (atomic_load_explicit(&car->req.applied, memory_order_acquire)) {
+      while (sem_wait(&car->answered)) {
+	if (errno != EINTR) {
+	  fprintf(stderr, "Error waiting for the combiner\n");
+	  return -1;
+	}
+      }
+      break;
+    }
+    int rc = pthread_mutex_trylock(&combiner.lock);
+    if (rc == EBUSY) {
+      sched_yield();
+      continue;
+    }
+    if (rc) {
+      fprintf(stderr, "Error acquiring the combiner lock\n");
+      return -1;
+    }
+    FAULT_POINT(FAULT_LOCK);
+    combine();
+    if (pthread_mutex_unlock(&combiner.lock)) {
+      fprintf(stderr, "Error releasing the combiner lock\n");
+      return -1;
+    }
+  }
+  FAULT_POINT(FAULT_WAKE);
+  return 0;
+}
+
+/* Handles a car arriving at the bridge in the combining architecture
+ *
+ * @param car a pointer to the arriving car
+ * @return 0 on success, -1 on error
+ */
+static int combining_arrive(car_t* car) {
+  if (sem_init(&car->answered, 0, 0)) {
+    fprintf(stderr, "Error initializing a car's semaphore\n");
+    return -1;
+  }
+  return combining_request(car, REQ_ARRIVE);
+}
+
+/* Handles a car exiting the bridge in the combining architecture
+ *
+ * @param car a pointer to the exiting car
+ * @return 0 on success, -1 on error
+ */
+static int combining_exit(car_t* car) {
+  int rc = combining_request(car, REQ_EXIT);
+  sem_destroy(&car->answered);
+  return rc;
+}
+
+/* Prepares the combining architecture with empty lobbies
+ *
+ * @return 0 on success, -1 on error
+ */
+static int combining_start(void) {
+  lobbies_init();
+  atomic_init(&combiner.pending, NULL);
+  if (pthread_mutex_init(&combiner.lock, NULL)) {
+    fprintf(stderr, "Error initializing the combiner lock\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Tears down the combining architecture once every car is done
+ *
+ * @return 0 on success, -1 on error
+ */
+static int combining_stop(void) {
+  if (pthread_mutex_destroy(&combiner.lock)) {
+    fprintf(stderr, "Error destroying the combiner lock\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Logs a car's event in the split architecture and publishes the lobby
+ * sizes for route choice and the status page. Logging goes to the car's
+ * own shard under its direction's lock alone. Directions change their own
+ * counts independently, so publishing takes the note lock to keep one
+ * writer at a time; only runs that publish pay for it
+ *
+ * @param car the car
+ * @param type TRACE_ARRIVE, TRACE_BOARD or TRACE_EXIT
+ */
+static void split_note(car_t* car, int type) {
+  if (ledyard.log)
+    replay_record(car, type);
+  if (ledyard.routes == NULL && ledyard.status == NULL)
+    return;
+  pthread_mutex_lock(&split.note);
+  int waiting[NUM_DIRECTIONS];
+  waiting[TO_HANOVER] = atomic_load_explicit(&split.waiting[TO_HANOVER], memory_order_relaxed);
+  waiting[TO_NORWICH] = atomic_load_explicit(&split.waiting[TO_NORWICH], memory_order_relaxed);
+  if (ledyard.routes)
+    route_publish(&ledyard.snapshot, waiting);
+  if (ledyard.status) {
+    // the last car off clears the direction just after its note
+    int on = atomic_load(&split.on[TO_HANOVER]) + atomic_load(&split.on[TO_NORWICH]);
+    note_status(car, type, on ? atomic_load(&split.dir) : NO_DIRECTION, on, waiting);
+  }
+  pthread_mutex_unlock(&split.note);
+}
+
+/* Handles a car arriving at the bridge in the split architecture. The
+ * car holds only its own direction's lock, and takes the flip lock too
+ * when it finds the bridge empty and turns traffic its way
+ *
+ * @param car a pointer to the arriving car
+ * @return 0 on success, -1 on mutex error or flawed invariant
+ */
+static int split_arrive(car_t* car) {
+  int d = car->dir;
+  if (pthread_mutex_lock(&split.lock[d])) {
+    fprintf(stderr, "Error acquiring a direction lock for split_arrive()\n");
+    return -1;
+  }
+  FAULT_POINT(FAULT_LOCK);
+  atomic_fetch_add(&split.waiting[d], 1);
+  split_note(car, TRACE_ARRIVE);
+
+  for (;;) {
+    int dir = atomic_load(&split.dir);
+    if (dir == d && atomic_load(&split.on[d]) < MAX_CARS)
+      break;
+    if (dir == NO_DIRECTION) {
+      if (pthread_mutex_lock(&split.flip)) {
+	fprintf(stderr, "Error acquiring the flip lock\n");
+	return -1;
+      }
+      FAULT_POINT(FAULT_LOCK);
+      // the other direction may have flipped first
+      if (atomic_load(&split.dir) == NO_DIRECTION)
+	atomic_store(&split.dir, d);
+      pthread_mutex_unlock(&split.flip);
+      continue;
+    }
+    if (pthread_cond_wait(&split.cond[d], &split.lock[d])) {
+      fprintf(stderr, "Error blocking thread on a condition variable\n");
+      return -1;
+    }
+    FAULT_POINT(FAULT_WAKE);
+  }
+
+  // error checking before editing bridge state
+  if (atomic_load(&split.dir) != d || atomic_load(&split.on[car->other_dir]) > 0) {
+    fprintf(stderr, "KABOOOM! You just caused a car crash!\n");
+    return -1;
+  }
+  if (atomic_load(&split.on[d]) >= MAX_CARS) {
+    fprintf(stderr, "KERSPLASH! Your bridge just collapsed from over-capacity!\n");
+    return -1;
+  }
+  atomic_fetch_sub(&split.waiting[d], 1);
+  atomic_fetch_add(&split.on[d], 1);
+  split_note(car, TRACE_BOARD);
+
+  if (pthread_mutex_unlock(&split.lock[d])) {
+    fprintf(stderr, "Error releasing a direction lock for split_arrive()\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Handles a car exiting the bridge in the split architecture. Only the
+ * last car off takes the flip lock, to clear the direction of traffic,
+ * and then wakes the other direction under that direction's lock, after
+ * releasing its own so the two locks are never held in opposite orders
+ *
+ * @param car a pointer to the exiting car
+ * @return 0 on success, -1 on mutex error
+ */
+static int split_exit(car_t* car) {
+  int d = car->dir, o = car->other_dir;
+  if (pthread_mutex_lock(&split.lock[d])) {
+    fprintf(stderr, "Error acquiring a direction lock for split_exit()\n");
+    return -1;
+  }
+  FAULT_POINT(FAULT_LOCK);
+  int empty = atomic_fetch_sub(&split.on[d], 1) == 1;
+  split_note(car, TRACE_EXIT);
+
+  if (empty) {
+    if (pthread_mutex_lock(&split.flip)) {
+      fprintf(stderr, "Error acquiring the flip lock\n");
+      return -1;
+    }
+    FAULT_POINT(FAULT_LOCK);
+    atomic_store(&split.dir, NO_DIRECTION);
+    pthread_mutex_unlock(&split.flip);
+  }
+  FAULT_POINT(FAULT_SIGNAL);
+  if ((empty ? pthread_cond_broadcast(&split.cond[d]) : pthread_cond_signal(&split.cond[d])) ||
+      pthread_mutex_unlock(&split.lock[d])) {
+    fprintf(stderr, "Error signaling or unlocking in split_exit()\n");
+    return -1;
+  }
+
+  // a car of the other direction checks the direction holding its own
+  // lock, so taking that lock here means none can miss this wakeup
+  if (empty) {
+    if (pthread_mutex_lock(&split.lock[o])) {
+      fprintf(stderr, "Error acquiring a direction lock for split_exit()\n");
+      return -1;
+    }
+    FAULT_POINT(FAULT_SIGNAL);
+    pthread_cond_broadcast(&split.cond[o]);
+    pthread_mutex_unlock(&split.lock[o]);
+  }
+  return 0;
+}
+
+/* Prepares the split architecture with an empty bridge
+ *
+ * @return 0 on success, -1 on error
+ */
+static int split_start(void) {
+  int d;
+  atomic_init(&split.dir, NO_DIRECTION);
+  for (d = 0; d < NUM_DIRECTIONS; d++) {
+    atomic_init(&split.waiting[d], 0);
+    atomic_init(&split.on[d], 0);
+    if (pthread_mutex_init(&split.lock[d], NULL) || pthread_cond_init(&split.cond[d], NULL)) {
+      fprintf(stderr, "Error initializing a direction's mutex or condition variable\n");
+      return -1;
+    }
+  }
+  if (pthread_mutex_init(&split.flip, NULL) || pthread_mutex_init(&split.note, NULL)) {
+    fprintf(stderr, "Error initializing the flip or note lock\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Tears down the split architecture once every car is done
+ *
+ * @return 0 on success, -1 on error
+ */
+static int split_stop(void) {
+  int d, rc = 0;
+  for (d = 0; d < NUM_DIRECTIONS; d++) {
+    if (pthread_mutex_destroy(&split.lock[d]) || pthread_cond_destroy(&split.cond[d]))
+      rc = -1;
+  }
+  if (pthread_mutex_destroy(&split.flip) || pthread_mutex_destroy(&split.note))
+    rc = -1;
+  if (rc)
+    fprintf(stderr, "Error destroying the split architecture's locks\n");
+  return rc;
+}
+
+// the architectures replayed cars can run on, the first being the default
+static const bridge_ops_t archs[] = {
+  { "mutex", NULL, NULL, arrive_bridge, exit_bridge },
+  { "actor", actor_start, actor_stop, actor_arrive, actor_exit },
+  { "combining", combining_start, combining_stop, combining_arrive, combining_exit },
+  { "split", split_start, split_stop, split_arrive, split_exit },
+};
+
 /* Handles one car thread's bridge-crossing. The life of the
  * car thread begins in this function. The argument is the
  * direction of the new car, and is reassigned as an int*. 
@@ -373,22 +1228,75 @@ static void* one_vehicle(void* vargp) {
   return NULL;
 }
 
-/************************ LOCAL PROGRAM FUNCTIONS *********************/
-
-/* Initialize the begining state of the ledyard bridge
- * with no direction, 0 cars on it, and 0 cars waiting.
- * Also initializes the mutex and the condition variables
+/* Handles one scripted car's bridge-crossing in a replay. Instead of
+ * random sleeps, the car arrives and crosses at its script's times,
+ * scaled to real time by ledyard.scale
  *
- * Note: the caller will destroy the mutex and two cond variables,
- * and free ledyard.str_dir later
- *
- * @return 0 on success, -1 on error initializing pthread mutex/condvar
+ * @param vargp a void* pointing to the car's entry in ledyard.script
+ * @return NULL as no return is needed when using pthread_create
+ */
+static void* replay_vehicle(void* vargp) {
+  const script_car_t* spec = vargp;
+  car_t car;
+
+  if (initialize_car(&car, spec->dir))
+    return NULL;
+  car.id = spec - ledyard.script;
+  if (ledyard.drivers && ledyard.drivers->patience > 0)
+    car.give_up = spec->arrive + draw_patience(&car);
+
+  replay_sleep_until(spec->arrive);
+  if (ledyard.routes && choose_detour(&car))
+    atomic_fetch_add(&ledyard.detoured, 1);
+  else if (bridge_ops->arrive(&car) == 0) {
+    replay_sleep_until(car.boarded + spec->cross);
+    bridge_ops->exit(&car);
+  }
+
+  free(car.str_dir);
+  return NULL;
+}
+
+/************************ LOCAL PROGRAM FUNCTIONS *********************/
+
+/* Initialize the begining state of the ledyard bridge
+ * with no direction, 0 cars on it, and 0 cars waiting.
+ * Also initializes the mutex and the condition variables
+ *
+ * Note: the caller will destroy the mutex and two cond variables,
+ * and free ledyard.str_dir later
+ *
+ * @return 0 on success, -1 on error initializing pthread mutex/condvar
  */
 static int initialize_bridge(void) {
-  if (pthread_mutex_init(&ledyard.lock, NULL) ||
-      pthread_cond_init(&ledyard.want_to_hanover, NULL) ||
-      pthread_cond_init(&ledyard.want_to_norwich, NULL)) {
-    fprintf(stderr, "Error initializing ledyard mutex or condition variables\n");
+  pthread_condattr_t attr;
+
+  if (pthread_condattr_init(&attr)) {
+    fprintf(stderr, "Error initializing ledyard condition variable attributes\n");
+    return -1;
+  }
+  // impatient drivers wait with deadlines on the replay's monotonic clock
+  if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)) {
+    fprintf(stderr, "Error setting the clock of ledyard condition variables\n");
+    goto fail_attr;
+  }
+  if (pthread_mutex_init(&ledyard.lock, NULL)) {
+    fprintf(stderr, "Error initializing ledyard mutex\n");
+    goto fail_attr;
+  }
+  if (pthread_cond_init(&ledyard.want_to_hanover, &attr)) {
+    fprintf(stderr, "Error initializing ledyard condition variable to Hanover\n");
+    goto fail_lock;
+  }
+  if (pthread_cond_init(&ledyard.want_to_norwich, &attr)) {
+    fprintf(stderr, "Error initializing ledyard condition variable to Norwich\n");
+    goto fail_hanover;
+  }
+  pthread_condattr_destroy(&attr);
+  if (outbuf_init(&ledyard.out, fileno(stdout), 0)) {
+    pthread_cond_destroy(&ledyard.want_to_norwich);
+    pthread_cond_destroy(&ledyard.want_to_hanover);
+    pthread_mutex_destroy(&ledyard.lock);
     return -1;
   }
   
@@ -398,8 +1306,25 @@ static int initialize_bridge(void) {
   ledyard.num_cars = 0;
   ledyard.wait_hanover = 0;
   ledyard.wait_norwich = 0;
+  ledyard.log = NULL;
+  ledyard.routes = NULL;
+  route_init(&ledyard.snapshot);
+  atomic_init(&ledyard.detoured, 0);
+  ledyard.drivers = NULL;
+  atomic_init(&ledyard.balked, 0);
+  atomic_init(&ledyard.reneged, 0);
+  ledyard.scale = 1.0; // replays rescale the clock
+  clock_gettime(CLOCK_MONOTONIC, &ledyard.start);
  
   return 0;
+
+ fail_hanover:
+  pthread_cond_destroy(&ledyard.want_to_hanover);
+ fail_lock:
+  pthread_mutex_destroy(&ledyard.lock);
+ fail_attr:
+  pthread_condattr_destroy(&attr);
+  return -1;
 }
 
 /* Introduces the user to the program, returning user-inputted
@@ -481,7 +1406,8 @@ static int* intro(int* total_cars) {
  * direction each new car thread begins with
  *
  * Notes: (1) Randomness throughout the program is used with rand(), seeded
- * with the somewhat random "stopwatch-selected" microseconds
+ * with the somewhat random "stopwatch-selected" microseconds, or with
+ * the LEDYARD_SEED environment variable when it is set
  * (2) total_cars must be passed in as sizeof() doesn't work on 
  * car_dirs once passed into simulation() bc it turns into int*
  *
@@ -496,10 +1422,15 @@ static void simulation(int total_cars, int* car_dirs) {
   int* chosen_dir; // bc pthread_create requires ptr, and &TO_HANOVER doesn't work
   pthread_t car[total_cars]; // the cars threads
 
-  // seeding random
-  struct timeval t;
-  gettimeofday(&t, NULL);      // UINT_MAX to ensure 32-bit system (max 2^16)
-  srand(t.tv_usec % UINT_MAX); // can handle possibly 6-digits 
+  // seeding random, from LEDYARD_SEED if set so the coin flips repeat
+  const char* seed = getenv("LEDYARD_SEED");
+  if (seed != NULL)
+    srand((unsigned) strtoul(seed, NULL, 10));
+  else {
+    struct timeval t;
+    gettimeofday(&t, NULL);      // UINT_MAX to ensure 32-bit system (max 2^16)
+    srand(t.tv_usec % UINT_MAX); // can handle possibly 6-digits 
+  }
 
   // beginning simulation
   if (car_dirs == NULL)
@@ -537,6 +1468,7 @@ static void simulation(int total_cars, int* car_dirs) {
     if (pthread_join(car[i], NULL))
       fprintf(stderr, "Error waiting for car thread %d to terminate\n", i);
   }
+  outbuf_flush(&ledyard.out); // all cars joined, so no lock is needed
 
   printf("\nAll cars have safely exited the bridge\n");
   printf("============= SIMULATION COMPLETED ==============\n");
@@ -566,6 +1498,79 @@ static void manage_sims(void) {
   free(buffer);
 }
 
+/* Replays scripted cars on the threaded bridge, one thread per car,
+ * logging every arrive/board/exit event in the order it took effect.
+ * Each car's events go to its own shard while it runs, so logging adds no
+ * shared writer, and the shards are merged by time at the end. The bridge
+ * must be initialized and idle
+ *
+ * @param ops the architecture the cars run on
+ * @param cars the cars to replay, in order of arrival
+ * @param n the number of cars
+ * @param scale real seconds per simulated second
+ * @param log where to save the events; must hold 3 * n records
+ * @return the number of events logged, or -1 on error creating threads
+ */
+static long replay_script(const bridge_ops_t* ops, const script_car_t* cars, int n, double scale,
+			  trace_record_t* log) {
+  pthread_t* threads = (pthread_t*) malloc(n * sizeof(pthread_t));
+  trace_record_t* shards = (trace_record_t*) malloc(3 * (size_t) n * sizeof(trace_record_t));
+  trace_record_t** heads = (trace_record_t**) malloc(n * sizeof(trace_record_t*));
+  size_t* lens = (size_t*) calloc(n, sizeof(size_t));
+  pthread_attr_t attr;
+  long merged = -1;
+  int i, started = 0;
+
+  if (threads == NULL || shards == NULL || heads == NULL || lens == NULL ||
+      pthread_attr_init(&attr)) {
+    fprintf(stderr, "Error allocating replay threads\n");
+    goto done;
+  }
+  pthread_attr_setstacksize(&attr, 64 * 1024); // cars need little stack
+  if (ops->start && ops->start()) {
+    pthread_attr_destroy(&attr);
+    goto done;
+  }
+
+  bridge_ops = ops;
+  ledyard.script = cars;
+  ledyard.log = shards;
+  ledyard.log_len = lens;
+  atomic_store(&ledyard.next_seq, 0);
+  ledyard.scale = scale;
+  clock_gettime(CLOCK_MONOTONIC, &ledyard.start);
+  for (i = 0; i < n; i++) {
+    if (pthread_create(&threads[i], &attr, replay_vehicle, (void*) &cars[i])) {
+      fprintf(stderr, "Error creating replay car thread %d\n", i);
+      break;
+    }
+    started++;
+  }
+  for (i = 0; i < started; i++) {
+    if (pthread_join(threads[i], NULL))
+      fprintf(stderr, "Error waiting for replay car thread %d to terminate\n", i);
+  }
+  if (ops->stop && ops->stop())
+    started = -1;
+
+  pthread_attr_destroy(&attr);
+  ledyard.log = NULL;
+  ledyard.log_len = NULL;
+  ledyard.script = NULL;
+  if (started == n) {
+    for (i = 0; i < n; i++)
+      heads[i] = shards + 3 * (size_t) i;
+    merged = trace_merge_shards(heads, lens, n, log);
+  }
+
+ done:
+  free(threads);
+  free(shards);
+  free(heads);
+  free(lens);
+  return merged;
+}
+
 /* Destroys the bridge's mutex and two condition variables, 
  * and frees ledyard.str_dir
  * 
@@ -580,7 +1585,7 @@ static int destroy_bridge(void) {
   free(ledyard.str_dir);
   ledyard.str_dir = NULL;
   
-  int destroy_error = 0;
+  int destroy_error = outbuf_destroy(&ledyard.out);
   if (pthread_mutex_destroy(&ledyard.lock)) {
     fprintf(stderr, "Error destroying ledyard mutex\n");
     destroy_error = -1;
@@ -597,20 +1602,1279 @@ static int destroy_bridge(void) {
   return destroy_error;
 }
 
+/* Applies one command line setting that is not part of the scenario
+ *
+ * @param cli the command line options to edit
+ * @param key the setting's name
+ * @param value the setting's value as text
+ * @return 0 if applied, 1 if key is not a command line option,
+ *         -1 on invalid value
+ */
+static int cli_set(cli_t* cli, const char* key, const char* value) {
+  if (strcmp(key, "mode") == 0) {
+    if (strlen(value) >= sizeof(cli->mode))
+      goto invalid;
+    strcpy(cli->mode, value);
+  }
+  else if (strcmp(key, "sweep") == 0) {
+    if (sscanf(value, "%lf:%lf:%d", &cli->sweep_lo, &cli->sweep_hi, &cli->sweep_steps) != 3 ||
+	cli->sweep_lo <= 0 || cli->sweep_hi < cli->sweep_lo || cli->sweep_steps < 1)
+      goto invalid;
+  }
+  else if (strcmp(key, "max-util") == 0 || strcmp(key, "max_util") == 0) {
+    if (sscanf(value, "%lf", &cli->max_util) != 1 || cli->max_util <= 0)
+      goto invalid;
+  }
+  else if (strcmp(key, "rare-threshold") == 0 || strcmp(key, "rare_threshold") == 0) {
+    if (parse_duration(value, &cli->rare.threshold) || cli->rare.threshold <= 0)
+      goto invalid;
+  }
+  else if (strcmp(key, "rare-runs") == 0 || strcmp(key, "rare_runs") == 0) {
+    if (sscanf(value, "%d", &cli->rare.runs) != 1 || cli->rare.runs < 2)
+      goto invalid;
+  }
+  else if (strcmp(key, "samples") == 0) {
+    if (sscanf(value, "%d", &cli->sens.samples) != 1 || cli->sens.samples < 2)
+      goto invalid;
+  }
+  else if (strcmp(key, "threads") == 0) {
+    if (sscanf(value, "%d", &cli->sens.threads) != 1 || cli->sens.threads < 1)
+      goto invalid;
+  }
+  else if (strcmp(key, "procs") == 0) {
+    if (sscanf(value, "%d", &cli->sens.procs) != 1 || cli->sens.procs < 0)
+      goto invalid;
+  }
+  else if (strcmp(key, "run-timeout") == 0 || strcmp(key, "run_timeout") == 0) {
+    if (parse_duration(value, &cli->sens.timeout) || cli->sens.timeout < 0)
+      goto invalid;
+  }
+  else if (strcmp(key, "time-scale") == 0 || strcmp(key, "time_scale") == 0) {
+    if (sscanf(value, "%lf", &cli->time_scale) != 1 || cli->time_scale <= 0)
+      goto invalid;
+  }
+  else if (strcmp(key, "alpha") == 0) {
+    if (sscanf(value, "%lf", &cli->alpha) != 1 || cli->alpha <= 0 || cli->alpha >= 1)
+      goto invalid;
+  }
+  else if (strcmp(key, "golden") == 0) {
+    if (strlen(value) >= sizeof(cli->golden))
+      goto invalid;
+    strcpy(cli->golden, value);
+  }
+  else if (strcmp(key, "update") == 0) {
+    if (sscanf(value, "%d", &cli->update) != 1)
+      goto invalid;
+  }
+  else if (strcmp(key, "faults") == 0) {
+    if (strlen(value) >= sizeof(cli->faults))
+      goto invalid;
+    strcpy(cli->faults, value);
+  }
+  else if (strcmp(key, "rounds") == 0) {
+    if (sscanf(value, "%d", &cli->rounds) != 1 || cli->rounds < 1)
+      goto invalid;
+  }
+  else if (strcmp(key, "repeat") == 0) {
+    if (sscanf(value, "%d", &cli->repeat) != 1 || cli->repeat < 1)
+      goto invalid;
+  }
+  else if (strcmp(key, "bench-dir") == 0 || strcmp(key, "bench_dir") == 0) {
+    if (strlen(value) >= sizeof(cli->bench_dir))
+      goto invalid;
+    strcpy(cli->bench_dir, value);
+  }
+  else if (strcmp(key, "arch") == 0) {
+    if (strlen(value) >= sizeof(cli->arch))
+      goto invalid;
+    strcpy(cli->arch, value);
+  }
+  else if (strcmp(key, "socket") == 0) {
+    if (strlen(value) >= sizeof(cli->socket))
+      goto invalid;
+    strcpy(cli->socket, value);
+  }
+  else if (strcmp(key, "shards") == 0) {
+    if (strlen(value) >= sizeof(cli->shards))
+      goto invalid;
+    strcpy(cli->shards, value);
+  }
+  else if (strcmp(key, "results") == 0) {
+    if (strlen(value) >= sizeof(cli->results))
+      goto invalid;
+    strcpy(cli->results, value);
+  }
+  else if (strcmp(key, "status") == 0) {
+    if (strlen(value) >= sizeof(cli->status))
+      goto invalid;
+    strcpy(cli->status, value);
+  }
+  else if (strcmp(key, "watch") == 0) {
+    if (parse_duration(value, &cli->watch) || cli->watch < 0)
+      goto invalid;
+  }
+  else if (strcmp(key, "factor") == 0) {
+    if (sens_set_range(&cli->sens, value))
+      goto invalid;
+  }
+  else
+    return 1;
+  return 0;
+
+ invalid:
+  fprintf(stderr, "Error, invalid setting '%s=%s'\n", key, value);
+  return -1;
+}
+
+/* Builds a scenario and command line options from settings of the form
+ * "--key value" or "--key=value"
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments, argv[0] being the program name
+ * @param sc the scenario to fill
+ * @param cli the command line options to fill
+ * @return 0 on success, -1 on invalid settings
+ */
+static int parse_settings(int argc, char* argv[], scenario_t* sc, cli_t* cli) {
+  char key[STR_LEN * 8];
+  int i, rc;
+
+  scenario_defaults(sc);
+  memset(cli, 0, sizeof(*cli));
+  strcpy(cli->mode, "run");
+  cli->max_util = 0.98;
+  rare_defaults(&cli->rare);
+  sens_defaults(&cli->sens);
+  cli->alpha = 0.01;
+  cli->rounds = 20;
+  cli->repeat = 10;
+  strcpy(cli->golden, "tests/golden");
+  for (i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value;
+    if (strncmp(arg, "--", 2) != 0) {
+      fprintf(stderr, "Error, expected a setting like --cars=100, got '%s'\n", arg);
+      return -1;
+    }
+    arg += 2;
+    const char* eq = strchr(arg, '=');
+    size_t len = eq ? (size_t) (eq - arg) : strlen(arg);
+    if (len >= sizeof(key)) {
+      fprintf(stderr, "Error, setting name too long: '%s'\n", argv[i]);
+      return -1;
+    }
+    memcpy(key, arg, len);
+    key[len] = '\0';
+    if (eq)
+      value = eq + 1;
+    else if (i + 1 < argc)
+      value = argv[++i];
+    else {
+      fprintf(stderr, "Error, setting '%s' is missing a value\n", key);
+      return -1;
+    }
+
+    if ((rc = cli_set(cli, key, value)) < 0)
+      return -1;
+    if (rc == 1 && scenario_set(sc, key, value))
+      return -1;
+  }
+  return 0;
+}
+
+/* Returns the microseconds elapsed since start on the monotonic clock */
+static double elapsed_usec(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+/* Rejects a demand calendar in a mode that works from the fixed rates:
+ * the closed-form estimate and the sweep and sensitivity factors scale
+ * rate[], which a calendar replaces
+ *
+ * @param sc the scenario
+ * @param mode the mode's name, for the message
+ * @return 0 if the scenario has fixed rates, -1 otherwise
+ */
+static int fixed_rates_only(const scenario_t* sc, const char* mode) {
+  if (scenario_has_calendar(sc)) {
+    fprintf(stderr, "Error, %s mode works from fixed rates and cannot follow a demand calendar\n",
+	    mode);
+    return -1;
+  }
+  return 0;
+}
+
+/* Prints the closed-form estimate of a scenario and how long it took
+ *
+ * @param sc the scenario to estimate
+ * @return 0 on success, -1 if the scenario follows a demand calendar
+ */
+static int run_analytic(const scenario_t* sc) {
+  analytic_t est;
+  struct timespec start;
+
+  if (fixed_rates_only(sc, "analytic"))
+    return -1;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  analytic_estimate(sc, &est);
+  double usec = elapsed_usec(&start);
+
+  printf("Utilisation: %.3f (%s)\n", est.utilisation, est.stable ? "stable" : "UNSTABLE");
+  printf("One-way capacity: %.0f cars/hour, switch-over %.1fs\n", est.capacity, est.switch_over);
+  if (est.stable) {
+    printf("Mean cycle: %.1fs\n", est.cycle);
+    printf("Predicted wait: %.1fs for Hanover, %.1fs for Norwich, %.1fs overall\n",
+	   est.wait[TO_HANOVER], est.wait[TO_NORWICH], est.mean_wait);
+  }
+  printf("Estimated in %.2f microseconds\n", usec);
+  return 0;
+}
+
+/* Writes one row per finished run to an Arrow table: its seed and rates,
+ * and the metrics the server answers with. Failed runs are left out
+ *
+ * @param path the file to create
+ * @param scs the runs' scenarios
+ * @param results their results
+ * @param status their RUN_ status, or NULL if all are done
+ * @param n the number of runs
+ * @return 0 on success, -1 on write error
+ */
+static int write_results(const char* path, const scenario_t* scs, const sim_result_t* results,
+			 const int* status, int n) {
+  static const arrow_column_t columns[] = {
+    { "seed", ARROW_UINT64 },
+    { "rate_hanover", ARROW_DOUBLE },  // cars per minute
+    { "rate_norwich", ARROW_DOUBLE },
+    { "arrived", ARROW_UINT64 },
+    { "crossed", ARROW_UINT64 },
+    { "detoured", ARROW_UINT64 },
+    { "balked", ARROW_UINT64 },
+    { "reneged", ARROW_UINT64 },
+    { "mean_renege_wait", ARROW_DOUBLE }, // seconds
+    { "mean_wait", ARROW_DOUBLE },     // seconds
+    { "max_wait", ARROW_DURATION_US },
+    { "mean_queue", ARROW_DOUBLE },    // cars
+    { "switches", ARROW_UINT64 },
+    { "end_time", ARROW_DURATION_US },
+  };
+  arrow_writer_t aw;
+  int i, rc = 0;
+
+  if (arrow_open(&aw, path, columns, sizeof(columns) / sizeof(columns[0])))
+    return -1;
+  for (i = 0; i < n && rc == 0; i++) {
+    const sim_result_t* r = &results[i];
+    if (status && status[i] != RUN_DONE)
+      continue;
+    uint64_t crossed = r->crossed[TO_HANOVER] + r->crossed[TO_NORWICH];
+    uint64_t reneged = r->reneged[TO_HANOVER] + r->reneged[TO_NORWICH];
+    arrow_set_int(&aw, 0, (int64_t) scs[i].seed);
+    arrow_set_double(&aw, 1, scs[i].rate[TO_HANOVER]);
+    arrow_set_double(&aw, 2, scs[i].rate[TO_NORWICH]);
+    arrow_set_int(&aw, 3, (int64_t) (r->arrived[TO_HANOVER] + r->arrived[TO_NORWICH]));
+    arrow_set_int(&aw, 4, (int64_t) crossed);
+    arrow_set_int(&aw, 5, (int64_t) (r->detoured[TO_HANOVER] + r->detoured[TO_NORWICH]));
+    arrow_set_int(&aw, 6, (int64_t) (r->balked[TO_HANOVER] + r->balked[TO_NORWICH]));
+    arrow_set_int(&aw, 7, (int64_t) reneged);
+    arrow_set_double(&aw, 8, reneged ? r->renege_wait_sum / reneged : 0.0);
+    arrow_set_double(&aw, 9, crossed ? r->wait_sum / crossed : 0.0);
+    arrow_set_int(&aw, 10, r->wait_max);
+    arrow_set_double(&aw, 11, r->end_time > 0 ? r->queue_area / ((double) r->end_time / SIM_SEC) : 0.0);
+    arrow_set_int(&aw, 12, (int64_t) r->switches);
+    arrow_set_int(&aw, 13, r->end_time);
+    rc = arrow_end_row(&aw);
+  }
+  return arrow_close(&aw) || rc ? -1 : 0;
+}
+
+/* Sweeps the total arrival rate (keeping each town's share) from
+ * cli->sweep_lo to cli->sweep_hi cars per minute. Every point is screened
+ * with the closed-form estimate first; points predicted to use more than
+ * cli->max_util of the bridge are reported but not simulated
+ *
+ * @param sc the scenario to sweep
+ * @param cli the sweep's range and screening threshold
+ * @return 0 on success, -1 on simulation error
+ */
+static int run_sweep(const scenario_t* sc, const cli_t* cli) {
+  double total = sc->rate[TO_HANOVER] + sc->rate[TO_NORWICH];
+  double share = total > 0 ? sc->rate[TO_HANOVER] / total : 0.5;
+  int steps = cli->sweep_steps;
+  int i, skipped = 0, num_runs = 0, rc = -1;
+
+  if (steps == 0) {
+    fprintf(stderr, "Error, sweep mode needs --sweep LO:HI:STEPS (cars per minute)\n");
+    return -1;
+  }
+  if (fixed_rates_only(sc, "sweep"))
+    return -1;
+  scenario_t* points = (scenario_t*) malloc(steps * sizeof(scenario_t));
+  analytic_t* ests = (analytic_t*) malloc(steps * sizeof(analytic_t));
+  sim_result_t* results = (sim_result_t*) malloc(steps * sizeof(sim_result_t));
+  int* status = (int*) malloc(steps * sizeof(int));
+  int* run_of = (int*) malloc(steps * sizeof(int));
+  if (points == NULL || ests == NULL || results == NULL || status == NULL || run_of == NULL) {
+    fprintf(stderr, "Error allocating sweep points\n");
+    goto done;
+  }
+
+  // screen every point first, then simulate the ones kept all at once
+  for (i = 0; i < steps; i++) {
+    scenario_t point = *sc;
+    double rate = steps == 1 ? cli->sweep_lo :
+      cli->sweep_lo + (cli->sweep_hi - cli->sweep_lo) * i / (steps - 1);
+    point.rate[TO_HANOVER] = rate * share;
+    point.rate[TO_NORWICH] = rate * (1 - share);
+    scenario_quiet(&point);
+    analytic_estimate(&point, &ests[i]);
+    run_of[i] = -1;
+    if (ests[i].utilisation < cli->max_util) {
+      run_of[i] = num_runs;
+      points[num_runs++] = point;
+    }
+  }
+  if (cli->sens.procs)
+    procpool_run(points, results, status, num_runs, cli->sens.procs, cli->sens.timeout);
+  else {
+    for (i = 0; i < num_runs; i++)
+      status[i] = des_run(&points[i], &results[i]) ? RUN_FAILED : RUN_DONE;
+  }
+
+  printf("%10s %8s %12s %12s\n", "cars/min", "util", "predicted", "simulated");
+  for (i = 0; i < steps; i++) {
+    double rate = steps == 1 ? cli->sweep_lo :
+      cli->sweep_lo + (cli->sweep_hi - cli->sweep_lo) * i / (steps - 1);
+    printf("%10.2f %8.3f ", rate, ests[i].utilisation);
+    if (ests[i].stable)
+      printf("%11.1fs ", ests[i].mean_wait);
+    else
+      printf("%12s ", "unstable");
+
+    int r = run_of[i];
+    if (r < 0) {
+      printf("%12s\n", "skipped");
+      skipped++;
+    }
+    else if (status[r] != RUN_DONE)
+      printf("%12s\n", status[r] == RUN_HUNG ? "hung" : "failed");
+    else {
+      uint64_t crossed = results[r].crossed[TO_HANOVER] + results[r].crossed[TO_NORWICH];
+      printf("%11.1fs\n", crossed ? results[r].wait_sum / crossed : 0.0);
+    }
+  }
+  if (skipped)
+    printf("%d point(s) predicted above %.2f utilisation were not simulated\n", skipped, cli->max_util);
+  rc = cli->results[0] ? write_results(cli->results, points, results, status, num_runs) : 0;
+  for (i = 0; i < num_runs; i++) {
+    if (status[i] != RUN_DONE)
+      rc = -1;
+  }
+
+ done:
+  free(points);
+  free(ests);
+  free(results);
+  free(status);
+  free(run_of);
+  return rc;
+}
+
+/* Converts a trace of either format to an Arrow table of its events
+ *
+ * @param tr the open trace
+ * @param trace_path the trace's file, for errors
+ * @param path the Arrow file to create
+ * @return 0 on success, -1 on write error or corrupt trace
+ */
+static int export_trace(trace_reader_t* tr, const char* trace_path, const char* path) {
+  static const arrow_column_t columns[] = {
+    { "time", ARROW_DURATION_US },
+    { "car", ARROW_UINT64 },
+    { "type", ARROW_INT8 }, // TRACE_ARRIVE, TRACE_BOARD, TRACE_EXIT or TRACE_RELEASE
+    { "dir", ARROW_INT8 },
+  };
+  arrow_writer_t aw;
+  trace_record_t rec;
+  int rc;
+
+  if (arrow_open(&aw, path, columns, sizeof(columns) / sizeof(columns[0])))
+    return -1;
+  while ((rc = trace_read(tr, &rec)) == 1) {
+    arrow_set_int(&aw, 0, rec.time);
+    arrow_set_int(&aw, 1, (int64_t) rec.car);
+    arrow_set_int(&aw, 2, rec.type);
+    arrow_set_int(&aw, 3, rec.dir);
+    if (arrow_end_row(&aw))
+      break;
+  }
+  if (rc < 0)
+    fprintf(stderr, "Error, trace file '%s' is corrupt\n", trace_path);
+  return arrow_close(&aw) || rc != 0 ? -1 : 0;
+}
+
+/* Prints a trace of either format as text on stdout, or converts it to
+ * the Arrow file given by arrow_path
+ *
+ * @param path the trace file
+ * @param arrow_path the Arrow file to create ("" to print)
+ * @return 0 on success, -1 on error or corrupt trace
+ */
+static int decode_trace(const char* path, const char* arrow_path) {
+  trace_reader_t tr;
+  trace_record_t rec;
+  outbuf_t out;
+  int rc;
+
+  if (path[0] == '\0') {
+    fprintf(stderr, "Error, decode mode needs --trace FILE\n");
+    return -1;
+  }
+  if (trace_reader_open(&tr, path))
+    return -1;
+  if (arrow_path[0]) {
+    rc = export_trace(&tr, path, arrow_path);
+    trace_reader_close(&tr);
+    return rc;
+  }
+  if (outbuf_init(&out, fileno(stdout), 0)) {
+    trace_reader_close(&tr);
+    return -1;
+  }
+  out.line_flush = 0;
+  while ((rc = trace_read(&tr, &rec)) == 1)
+    trace_format_text(&out, &rec);
+  if (rc < 0)
+    fprintf(stderr, "Error, trace file '%s' is corrupt\n", path);
+
+  trace_reader_close(&tr);
+  return outbuf_destroy(&out) || rc < 0 ? -1 : 0;
+}
+
+/* Estimates the probability of a wait longer than --rare-threshold with
+ * cross-entropy importance sampling. Runs are limited by the scenario's
+ * horizon (2 hours unless given) rather than a number of cars
+ *
+ * @param sc the scenario to estimate
+ * @param cli the estimate's options
+ * @return 0 on success, -1 on simulation error
+ */
+static int run_rare(scenario_t* sc, const cli_t* cli) {
+  rare_result_t est;
+
+  sc->cars = 0;
+  if (sc->horizon == 0)
+    sc->horizon = 2 * SIM_HOUR;
+  scenario_quiet(sc);
+  if (rare_estimate(sc, &cli->rare, &est))
+    return -1;
+
+  printf("Tilted arrival rates: %.3f to Hanover, %.3f to Norwich cars/min (%d rounds%s)\n",
+	 est.rate[TO_HANOVER], est.rate[TO_NORWICH], est.levels,
+	 est.reached ? "" : ", threshold NOT reached");
+  printf("P(a car waits over %.1f minutes): %.3e +/- %.1f%%\n",
+	 (double) cli->rare.threshold / SIM_MIN, est.p_car, 100 * est.re_car);
+  printf("P(any car in a %.0f minute run waits that long): %.3e +/- %.1f%%\n",
+	 (double) sc->horizon / SIM_MIN, est.p_run, 100 * est.re_run);
+  printf("Simulated %llu cars (%llu past the threshold); ",
+	 (unsigned long long) est.cars, (unsigned long long) est.hits);
+  if (est.plain_cars > 0)
+    printf("plain simulation would need about %.2e cars\n", est.plain_cars);
+  else
+    printf("no long waits were observed\n");
+  return 0;
+}
+
+/* Ranks how much each factor drives the mean wait, with Morris elementary
+ * effects or Sobol indices. Every design point uses the scenario's seed
+ *
+ * @param sc the base scenario
+ * @param cli the analysis' factor ranges, samples and threads
+ * @param sobol nonzero for Sobol indices, zero for Morris effects
+ * @return 0 on success, -1 on simulation error
+ */
+static int run_sensitivity(const scenario_t* sc, const cli_t* cli, int sobol) {
+  double a[NUM_FACTORS], b[NUM_FACTORS];
+  struct timespec start;
+  int i, runs = 0, rc;
+
+  if (fixed_rates_only(sc, sobol ? "sobol" : "morris"))
+    return -1;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (sobol)
+    rc = sens_sobol(sc, &cli->sens, a, b, &runs);
+  else
+    rc = sens_morris(sc, &cli->sens, a, b, &runs);
+  if (rc)
+    return -1;
+  double secs = elapsed_usec(&start) / 1e6;
+
+  printf("%-10s %14s %8s %12s\n", "factor", "range",
+	 sobol ? "S1" : "mu*", sobol ? "ST" : "sigma");
+  for (i = 0; i < NUM_FACTORS; i++) {
+    const sens_factor_t* f = &cli->sens.factors[i];
+    char range[32];
+    snprintf(range, sizeof(range), "%g:%g", f->lo, f->hi);
+    if (sobol)
+      printf("%-10s %14s %8.3f %12.3f\n", f->name, range, a[i], b[i]);
+    else
+      printf("%-10s %14s %7.1fs %11.1fs\n", f->name, range, a[i], b[i]);
+  }
+  printf("%d simulations on %d %s in %.2fs\n", runs,
+	 cli->sens.procs ? cli->sens.procs : cli->sens.threads,
+	 cli->sens.procs ? "process(es)" : "thread(s)", secs);
+  return 0;
+}
+
+/* Limits a scenario to what the threaded bridge simulates: MAX_CARS, no
+ * switch-over time, batch limit or incidents, and a number of cars
+ *
+ * @param sc the scenario to edit
+ */
+static void threaded_rules(scenario_t* sc) {
+  sc->capacity = MAX_CARS;
+  sc->switch_time = 0;
+  sc->batch_limit = 0;
+  sc->num_incidents = 0;
+  sc->horizon = 0;
+  scenario_quiet(sc);
+}
+
+/* Returns the threaded bridge architecture with a name
+ *
+ * @param name the architecture's name, or "" for the default
+ * @return the architecture, or NULL if there is none by that name
+ */
+static const bridge_ops_t* find_arch(const char* name) {
+  size_t i;
+  if (name[0] == '\0')
+    return &archs[0];
+  for (i = 0; i < sizeof(archs) / sizeof(archs[0]); i++) {
+    if (strcmp(archs[i].name, name) == 0)
+      return &archs[i];
+  }
+  fprintf(stderr, "Error, unknown bridge architecture '%s'\n", name);
+  return NULL;
+}
+
+/* Prints one engine's line of a differential test
+ *
+ * @param name the engine's name
+ * @param log what its event log showed
+ * @param n the number of cars
+ */
+static void print_diff_log(const char* name, const diff_log_t* log, int n) {
+  double sum = 0, max = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    sum += log->waits[i];
+    if (log->waits[i] > max)
+      max = log->waits[i];
+  }
+  printf("%-9s %-10s %10.1fs %10.1fs %8d\n", name, log->ok ? "ok" : "BROKEN",
+	 sum / n, max, log->max_on_bridge);
+  if (!log->ok)
+    printf("          %s\n", log->why);
+}
+
+/* Runs the threaded bridge and the discrete-event engine on the same
+ * scripted cars, checks both event logs for the bridge's invariants and
+ * compares their waits. The threaded bridge's rules are fixed (MAX_CARS,
+ * no switch-over time, batch limit or incidents), so the discrete-event
+ * engine runs under the same rules whatever the scenario says
+ *
+ * @param sc the scenario giving the cars' seed, count, rates and crossings
+ * @param cli the replay's time scale and the test's significance level
+ * @return 0 if both engines are safe and their waits agree, -1 otherwise
+ */
+static int run_diff(scenario_t* sc, const cli_t* cli) {
+  script_car_t* cars = NULL;
+  trace_record_t* logs = NULL;
+  double* waits = NULL;
+  diff_log_t threaded, des;
+  des_script_t script;
+  sim_result_t res;
+  double scale = cli->time_scale ? cli->time_scale : DIFF_SCALE;
+  const bridge_ops_t* ops = find_arch(cli->arch);
+  int n, i, rc = -1;
+
+  if (ops == NULL)
+    return -1;
+  threaded_rules(sc);
+  if (sc->detour_queue > 0 || sc->balk_queue > 0 || sc->patience > 0) {
+    fprintf(stderr, "Error, differential tests cannot use route choice or impatient drivers, "
+	    "as each engine's drivers see different queues\n");
+    return -1;
+  }
+  if (cli->faults[0] && fault_configure(cli->faults, sc->seed))
+    return -1;
+  if ((n = des_make_script(sc, &cars)) < 0)
+    return -1;
+  logs = (trace_record_t*) malloc(6 * (size_t) n * sizeof(trace_record_t));
+  waits = (double*) calloc(2 * (size_t) n, sizeof(double));
+  if (logs == NULL || waits == NULL) {
+    fprintf(stderr, "Error allocating differential test logs\n");
+    goto done;
+  }
+  threaded.waits = waits;
+  des.waits = waits + n;
+
+  printf("Replaying %d cars on both engines (%s bridge), %.0f real ms per simulated minute...\n",
+	 n, ops->name, scale * 60 * 1e3);
+  fflush(stdout);
+  if (initialize_bridge())
+    goto done;
+  long len = replay_script(ops, cars, n, scale, logs);
+  if (destroy_bridge() || len < 0)
+    goto done;
+  diff_check(logs, len, n, MAX_CARS, 0, 0, &threaded);
+
+  script.cars = cars;
+  script.n = n;
+  script.log = logs + 3 * (size_t) n;
+  if (des_run_script(sc, &res, &script))
+    goto done;
+  diff_check(script.log, script.log_len, n, MAX_CARS, 0, 0, &des);
+
+  printf("%-9s %-10s %11s %11s %8s\n", "engine", "invariants", "mean wait", "max wait", "max cars");
+  print_diff_log("threaded", &threaded, n);
+  print_diff_log("des", &des, n);
+
+  double paired = 0, d;
+  for (i = 0; i < n; i++)
+    paired += fabs(threaded.waits[i] - des.waits[i]);
+  // a millisecond of real scheduling jitter is not a difference in waits
+  double p = diff_ks(threaded.waits, n, des.waits, n, 1e-3 / scale, &d);
+  printf("Same car's waits differ by %.2fs on average\n", paired / n);
+  printf("Kolmogorov-Smirnov D = %.4f, p = %.4f: waits %s at alpha %.3g\n", d, p,
+	 p < cli->alpha ? "DIFFER" : "agree", cli->alpha);
+  if (fault_armed)
+    printf("%ld faults injected\n", fault_count());
+  rc = threaded.ok && des.ok && p >= cli->alpha ? 0 : -1;
+
+ done:
+  free(cars);
+  free(logs);
+  free(waits);
+  return rc;
+}
+
+/* Ends a stress test that stopped making progress. Only async-signal-safe
+ * calls are made
+ */
+static void stress_stuck(int sig) {
+  static const char msg[] = "\nStress round made no progress; a car missed its wakeup\n";
+  (void) sig;
+  if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0)
+    _exit(2);
+  _exit(2);
+}
+
+/* Replays many scripts of cars on the threaded bridge with faults
+ * injected at its lock and signal points (--faults, or a default mix of
+ * delays and yields), checking every event log for the bridge's
+ * invariants. A round that does not finish in time is reported as a lost
+ * wakeup and ends the test
+ *
+ * @param sc the scenario giving the cars' count, rates and crossings; each
+ *           round uses the next seed
+ * @param cli the rounds, time scale and faults
+ * @return 0 if every round kept the invariants, -1 otherwise
+ */
+static int run_stress(scenario_t* sc, const cli_t* cli) {
+  double scale = cli->time_scale ? cli->time_scale : STRESS_SCALE;
+  struct sigaction sa;
+  struct timespec start;
+  diff_log_t check;
+  long detoured = 0, balked = 0, reneged = 0;
+  int r, failed = 0;
+  const bridge_ops_t* ops = find_arch(cli->arch);
+
+  if (ops == NULL)
+    return -1;
+  threaded_rules(sc);
+  if ((sc->balk_queue > 0 || sc->patience > 0) && ops != &archs[0]) {
+    fprintf(stderr, "Error, only the %s bridge has impatient drivers\n", archs[0].name);
+    return -1;
+  }
+  if (fault_configure(cli->faults[0] ? cli->faults : STRESS_FAULTS, sc->seed))
+    return -1;
+  trace_record_t* log = (trace_record_t*) malloc(3 * (size_t) sc->cars * sizeof(trace_record_t));
+  check.waits = (double*) malloc(sc->cars * sizeof(double));
+  if (log == NULL || check.waits == NULL) {
+    fprintf(stderr, "Error allocating stress test logs\n");
+    free(log);
+    free(check.waits);
+    return -1;
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stress_stuck;
+  sigaction(SIGALRM, &sa, NULL);
+  double total = sc->rate[TO_HANOVER] + sc->rate[TO_NORWICH];
+  unsigned timeout = 10 + (unsigned) (4 * sc->cars / total * 60 * scale);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t seed = sc->seed;
+  for (r = 0; r < cli->rounds && failed == 0; r++) {
+    script_car_t* cars;
+    sc->seed = seed + r;
+    int n = des_make_script(sc, &cars);
+    if (n < 0 || initialize_bridge()) {
+      failed++;
+      break;
+    }
+    if (sc->detour_queue > 0)
+      ledyard.routes = sc;
+    if (sc->balk_queue > 0 || sc->patience > 0)
+      ledyard.drivers = sc;
+    alarm(timeout);
+    long len = replay_script(ops, cars, n, scale, log);
+    alarm(0);
+    detoured += atomic_load(&ledyard.detoured);
+    balked += atomic_load(&ledyard.balked);
+    reneged += atomic_load(&ledyard.reneged);
+    if (destroy_bridge() || len < 0)
+      failed++;
+    else {
+      diff_check(log, len, n, MAX_CARS, sc->detour_queue > 0 || sc->balk_queue > 0,
+		 sc->patience > 0, &check);
+      if (check.ok && check.detoured + check.reneged !=
+	  atomic_load(&ledyard.detoured) + atomic_load(&ledyard.balked) + atomic_load(&ledyard.reneged)) {
+	printf("FAIL round %d (seed %llu): cars that left the queue were miscounted\n", r,
+	       (unsigned long long) sc->seed);
+	failed++;
+      }
+      if (!check.ok) {
+	printf("FAIL round %d (seed %llu): %s\n", r, (unsigned long long) sc->seed, check.why);
+	failed++;
+      }
+    }
+    free(cars);
+  }
+
+  printf("%d round(s) of %ld cars on the %s bridge, %ld faults injected, %d failed, in %.2fs\n",
+	 r, sc->cars, ops->name, fault_count(), failed, elapsed_usec(&start) / 1e6);
+  if (sc->detour_queue > 0)
+    printf("%ld car(s) took the detour\n", detoured);
+  if (sc->balk_queue > 0 || sc->patience > 0)
+    printf("%ld driver(s) balked, %ld gave up waiting\n", balked, reneged);
+  free(log);
+  free(check.waits);
+  return failed ? -1 : 0;
+}
+
+/* Orders strings, for qsort() on an array of char* */
+static int by_name(const void* a, const void* b) {
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/* Compares two text files line by line
+ *
+ * @param path the file to check
+ * @param golden the file it should equal
+ * @return 0 if equal, the first differing line (from 1) otherwise,
+ *         or -1 if either file cannot be read
+ */
+static long compare_files(const char* path, const char* golden) {
+  char a[STR_LEN * 32], b[STR_LEN * 32];
+  long line = 0;
+  FILE* fa = fopen(path, "r");
+  FILE* fb = fopen(golden, "r");
+  if (fa == NULL || fb == NULL) {
+    if (fa)
+      fclose(fa);
+    if (fb)
+      fclose(fb);
+    return -1;
+  }
+
+  for (;;) {
+    char* ra = fgets(a, sizeof(a), fa);
+    char* rb = fgets(b, sizeof(b), fb);
+    line++;
+    if (ra == NULL || rb == NULL) {
+      line = ra == rb ? 0 : line; // equal only if both ended
+      break;
+    }
+    if (strcmp(a, b) != 0)
+      break;
+  }
+  fclose(fa);
+  fclose(fb);
+  return line;
+}
+
+/* Frees a list of names from list_files() */
+static void free_names(char** names, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    free(names[i]);
+  free(names);
+}
+
+/* Lists the files of a directory with a suffix (such as NAME.scn) in
+ * name order
+ *
+ * @param path the directory
+ * @param suffix the file names' ending
+ * @param out where to save the allocated file names; free with free_names()
+ * @return the number of names, or -1 on error
+ */
+static int list_files(const char* path, const char* suffix, char*** out) {
+  char** names = NULL;
+  int n = 0;
+  struct dirent* entry;
+
+  size_t suffix_len = strlen(suffix);
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    fprintf(stderr, "Error opening directory '%s'\n", path);
+    return -1;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > suffix_len && strcmp(entry->d_name + len - suffix_len, suffix) == 0) {
+      char** grown = (char**) realloc(names, (n + 1) * sizeof(char*));
+      if (grown == NULL || (grown[n] = strdup(entry->d_name)) == NULL) {
+	fprintf(stderr, "Error listing '%s' files in '%s'\n", suffix, path);
+	free_names(grown ? grown : names, n);
+	closedir(dir);
+	return -1;
+      }
+      names = grown;
+      n++;
+    }
+  }
+  closedir(dir);
+  qsort(names, n, sizeof(char*), by_name);
+  *out = names;
+  return n;
+}
+
+/* Replays every golden scenario (NAME.scn, one key=value setting per line)
+ * in cli->golden on the discrete-event engine and compares its text trace
+ * with the stored NAME.trc. Runs are seeded, so any difference is a change
+ * in the engine's behaviour. With cli->update, the traces are rewritten
+ *
+ * @param cli the golden directory and whether to update it
+ * @return 0 if every trace matched (or was written), -1 otherwise
+ */
+static int run_golden(const cli_t* cli) {
+  char scn[PATH_LEN * 2], trc[PATH_LEN * 2], tmp[PATH_LEN];
+  char** names;
+  int i, failed = 0;
+  struct timespec start;
+  size_t len;
+
+  int num_names = list_files(cli->golden, ".scn", &names);
+  if (num_names < 0)
+    return -1;
+
+  const char* tmpdir = getenv("TMPDIR");
+  snprintf(tmp, sizeof(tmp), "%s/ledyard-golden-XXXXXX", tmpdir ? tmpdir : "/tmp");
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    fprintf(stderr, "Error creating a temporary trace file\n");
+    failed = 1;
+  }
+  else
+    close(fd);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < num_names && fd >= 0; i++) {
+    scenario_t sc;
+    sim_result_t res;
+    len = strlen(names[i]) - 4;
+    snprintf(scn, sizeof(scn), "%s/%s", cli->golden, names[i]);
+    snprintf(trc, sizeof(trc), "%s/%.*s.trc", cli->golden, (int) len, names[i]);
+
+    scenario_defaults(&sc);
+    if (scenario_read(&sc, scn)) {
+      failed++;
+      continue;
+    }
+    scenario_quiet(&sc);
+    sc.trace_format = TRACE_TEXT;
+    const char* out = cli->update ? trc : tmp;
+    if (strlen(out) >= sizeof(sc.trace)) {
+      printf("FAIL %.*s: trace path %s is too long\n", (int) len, names[i], out);
+      failed++;
+      continue;
+    }
+    strcpy(sc.trace, out);
+    if (des_run(&sc, &res)) {
+      printf("FAIL %.*s: scenario did not run\n", (int) len, names[i]);
+      failed++;
+      continue;
+    }
+    if (cli->update)
+      continue;
+
+    long line = compare_files(tmp, trc);
+    if (line < 0) {
+      printf("FAIL %.*s: no golden trace %s\n", (int) len, names[i], trc);
+      failed++;
+    }
+    else if (line > 0) {
+      printf("FAIL %.*s: trace differs from line %ld\n", (int) len, names[i], line);
+      failed++;
+    }
+  }
+  double msec = elapsed_usec(&start) / 1e3;
+  if (fd >= 0)
+    unlink(tmp);
+
+  printf("%d golden scenario(s) %s, %d failed, in %.1fms (%.0f per second)\n", num_names,
+	 cli->update ? "written" : "checked", failed, msec, msec > 0 ? num_names / msec * 1e3 : 0.0);
+  free_names(names, num_names);
+  return failed ? -1 : 0;
+}
+
+/* Times repeated runs of one scenario, printing one benchmark line per
+ * run after an untimed warm-up run
+ *
+ * @param name the scenario's name in the benchmark output
+ * @param sc the scenario
+ * @param repeat the number of timed runs
+ * @return 0 on success, -1 on simulation error
+ */
+static int bench_scenario(const char* name, scenario_t* sc, int repeat) {
+  sim_result_t res;
+  struct timespec start;
+  int r;
+
+  scenario_quiet(sc);
+  if (des_run(sc, &res))
+    return -1;
+  for (r = 0; r < repeat; r++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (des_run(sc, &res))
+      return -1;
+    double usec = elapsed_usec(&start);
+    uint64_t cars = res.arrived[TO_HANOVER] + res.arrived[TO_NORWICH];
+    uint64_t crossed = res.crossed[TO_HANOVER] + res.crossed[TO_NORWICH];
+    printf("bench scenario=%s arch=des run=%d cars=%llu wall_us=%.1f cars_per_sec=%.0f "
+	   "mean_wait=%.6f\n", name, r, (unsigned long long) cars, usec, usec > 0 ? cars / usec * 1e6 : 0.0,
+	   crossed ? res.wait_sum / crossed : 0.0);
+  }
+  fflush(stdout);
+  return 0;
+}
+
+/* Times repeated replays of one scenario's scripted cars on a threaded
+ * bridge, printing one benchmark line per replay after an untimed warm-up
+ * replay. Every replay runs the same script, so replays differ only by
+ * how the cars share the bridge
+ *
+ * @param name the scenario's name in the benchmark output
+ * @param sc the scenario, limited to what the threaded bridge simulates
+ * @param ops the architecture the cars run on
+ * @param scale real seconds per simulated second
+ * @param repeat the number of timed replays
+ * @return 0 on success, -1 on invalid scenario or replay error
+ */
+static int bench_threaded(const char* name, scenario_t* sc, const bridge_ops_t* ops,
+			  double scale, int repeat) {
+  script_car_t* cars;
+  struct timespec start;
+  int r, rc = 0;
+
+  if (sc->cars == 0) {
+    printf("# %s skipped: only limited by its horizon, which replays do not have\n", name);
+    return 0;
+  }
+  threaded_rules(sc);
+  if ((sc->balk_queue > 0 || sc->patience > 0) && ops != &archs[0]) {
+    printf("# %s skipped: only the %s bridge has impatient drivers\n", name, archs[0].name);
+    return 0;
+  }
+  int n = des_make_script(sc, &cars);
+  if (n < 0)
+    return -1;
+  trace_record_t* log = (trace_record_t*) malloc(3 * (size_t) n * sizeof(trace_record_t));
+  if (log == NULL) {
+    fprintf(stderr, "Error allocating the benchmark's event log\n");
+    free(cars);
+    return -1;
+  }
+
+  for (r = -1; r < repeat && rc == 0; r++) {
+    if (initialize_bridge()) {
+      rc = -1;
+      break;
+    }
+    if (sc->detour_queue > 0)
+      ledyard.routes = sc;
+    if (sc->balk_queue > 0 || sc->patience > 0)
+      ledyard.drivers = sc;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long len = replay_script(ops, cars, n, scale, log);
+    double usec = elapsed_usec(&start);
+    if (destroy_bridge() || len < 0)
+      rc = -1;
+    else if (r >= 0)
+      printf("bench scenario=%s arch=%s run=%d cars=%d wall_us=%.1f cars_per_sec=%.0f\n", name,
+	     ops->name, r, n, usec, usec > 0 ? n / usec * 1e6 : 0.0);
+  }
+  fflush(stdout);
+  free(log);
+  free(cars);
+  return rc;
+}
+
+/* Times one scenario on the discrete-event engine, or, given an
+ * architecture, replays its cars on that threaded bridge
+ *
+ * @param ops the architecture, or NULL for the discrete-event engine
+ * @return 0 on success, -1 on error
+ */
+static int bench_one(const char* name, scenario_t* sc, const bridge_ops_t* ops, const cli_t* cli) {
+  if (ops == NULL)
+    return bench_scenario(name, sc, cli->repeat);
+  return bench_threaded(name, sc, ops, cli->time_scale ? cli->time_scale : BENCH_SCALE,
+			cli->repeat);
+}
+
+/* Prints machine-readable benchmark results for the scenario on the
+ * command line, or for every scenario file in --bench-dir, one line per
+ * timed run. Compare two such outputs with the benchcmp tool. Runs time
+ * the discrete-event engine, or with --arch, replays on that threaded
+ * bridge, so that two locking variants can be compared
+ *
+ * @param sc the command line's scenario
+ * @param cli the number of runs, the scenario directory and the
+ *        architecture, if any
+ * @return 0 on success, -1 on invalid scenario or simulation error
+ */
+static int run_bench(scenario_t* sc, const cli_t* cli) {
+  char path[PATH_LEN * 2];
+  char** names;
+  int i, rc = 0;
+  const bridge_ops_t* ops = NULL;
+
+  if (cli->arch[0] && (ops = find_arch(cli->arch)) == NULL)
+    return -1;
+  printf("# ledyard bench: one line per timed run; compare with benchcmp\n");
+  if (cli->bench_dir[0] == '\0')
+    return bench_one("cli", sc, ops, cli);
+
+  int n = list_files(cli->bench_dir, ".scn", &names);
+  if (n < 0)
+    return -1;
+  for (i = 0; i < n && rc == 0; i++) {
+    scenario_t file_sc;
+    snprintf(path, sizeof(path), "%s/%s", cli->bench_dir, names[i]);
+    names[i][strlen(names[i]) - 4] = '\0'; // the name without ".scn"
+    scenario_defaults(&file_sc);
+    rc = scenario_read(&file_sc, path) || bench_one(names[i], &file_sc, ops, cli) ? -1 : 0;
+  }
+  free_names(names, n);
+  return rc;
+}
+
+/* Merges every trace shard (NAME.trc) in --shards into the trace given by
+ * --trace, in time order. Shards may be of either format; the merged
+ * trace takes --trace-format
+ *
+ * @param sc gives the merged trace's file and format
+ * @param cli gives the shards' directory
+ * @return 0 on success, -1 on a missing, corrupt or unordered shard
+ */
+static int run_merge(const scenario_t* sc, const cli_t* cli) {
+  char path[PATH_LEN * 2];
+  char** names;
+  trace_writer_t tw;
+  struct timespec start;
+  int i, opened = 0, rc = -1;
+
+  if (cli->shards[0] == '\0' || sc->trace[0] == '\0') {
+    fprintf(stderr, "Error, merge mode needs --shards DIR and --trace FILE\n");
+    return -1;
+  }
+  int n = list_files(cli->shards, ".trc", &names);
+  if (n < 0)
+    return -1;
+  trace_reader_t* inputs = (trace_reader_t*) malloc((n > 0 ? n : 1) * sizeof(trace_reader_t));
+  if (inputs == NULL) {
+    fprintf(stderr, "Error allocating %d trace readers\n", n);
+    free_names(names, n);
+    return -1;
+  }
+  for (opened = 0; opened < n; opened++) {
+    snprintf(path, sizeof(path), "%s/%s", cli->shards, names[opened]);
+    if (trace_reader_open(&inputs[opened], path))
+      goto done;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (trace_open(&tw, sc->trace, sc->trace_format))
+    goto done;
+  long merged = trace_merge(inputs, n, &tw);
+  if (trace_close(&tw) == 0 && merged >= 0) {
+    printf("Merged %ld events from %d shard(s) in %.2fs\n", merged, n,
+	   elapsed_usec(&start) / 1e6);
+    rc = 0;
+  }
+
+ done:
+  for (i = 0; i < opened; i++)
+    trace_reader_close(&inputs[i]);
+  free(inputs);
+  free_names(names, n);
+  return rc;
+}
+
+/* Runs stress or diff mode, publishing the threaded bridge's state on
+ * the status page given by --status, if any
+ *
+ * @param sc the scenario to replay
+ * @param cli the mode and its options
+ * @return the mode's result, or -1 if the page cannot be created
+ */
+static int run_replays(scenario_t* sc, const cli_t* cli) {
+  if (cli->status[0] && (ledyard.status = statpage_create(cli->status)) == NULL)
+    return -1;
+  int rc = strcmp(cli->mode, "stress") == 0 ? run_stress(sc, cli) : run_diff(sc, cli);
+  if (ledyard.status)
+    statpage_close(ledyard.status);
+  ledyard.status = NULL;
+  return rc;
+}
+
+/* Prints a status page's state as one line of key=value fields: the
+ * direction of traffic, the cars on the bridge, waiting and crossed
+ * towards Hanover and Norwich, and the boarded cars' waits per
+ * histogram bucket (see STATPAGE_BUCKETS)
+ *
+ * @param cli gives the page's file and how often to reread it
+ * @return 0 on success, -1 if the page cannot be opened
+ */
+static int run_monitor(const cli_t* cli) {
+  statpage_view_t v;
+  int d, b;
+
+  if (cli->status[0] == '\0') {
+    fprintf(stderr, "Error, monitor mode needs --status FILE\n");
+    return -1;
+  }
+  const statpage_t* page = statpage_open(cli->status);
+  if (page == NULL)
+    return -1;
+  for (;;) {
+    statpage_read(page, &v);
+    printf("status seq=%u time=%.3f dir=%s on=%d waiting=%d,%d crossed=%llu,%llu", v.seq / 2,
+	   (double) v.updated / SIM_SEC,
+	   v.dir == TO_HANOVER ? "Hanover" : v.dir == TO_NORWICH ? "Norwich" : "Neither",
+	   v.num_cars, v.waiting[TO_HANOVER], v.waiting[TO_NORWICH],
+	   (unsigned long long) v.crossed[TO_HANOVER], (unsigned long long) v.crossed[TO_NORWICH]);
+    for (d = 0; d < NUM_DIRECTIONS; d++) {
+      printf(" waits_%s=", d == TO_HANOVER ? "hanover" : "norwich");
+      for (b = 0; b < STATPAGE_BUCKETS; b++)
+	printf("%s%llu", b ? "," : "", (unsigned long long) v.waits[d][b]);
+    }
+    printf("\n");
+    fflush(stdout);
+    if (cli->watch == 0)
+      break;
+    struct timespec pause = { cli->watch / SIM_SEC, cli->watch % SIM_SEC * 1000 };
+    nanosleep(&pause, NULL);
+  }
+  statpage_close(page);
+  return 0;
+}
+
+/* Runs the mode picked on the command line:
+ *   run      -- simulate the scenario on the discrete-event engine (default)
+ *   decode   -- print the trace file given by --trace as text, or
+ *               convert it to the Arrow file given by --arrow
+ *   analytic -- print the closed-form estimate of the scenario
+ *   sweep    -- screen and simulate a range of arrival rates
+ *   rare     -- estimate the probability of very long waits
+ *   morris   -- rank factors by Morris elementary effects on the mean wait
+ *   sobol    -- split the mean wait's variance into Sobol indices
+ *   diff     -- check the threaded bridge against the discrete-event engine
+ *   golden   -- check the discrete-event engine against stored traces
+ *   stress   -- replay the threaded bridge with injected faults
+ *   bench    -- time repeated runs, printing machine-readable results
+ *   serve    -- answer scenario requests from stdin or --socket, see server.h
+ *   monitor  -- print the status page given by --status, see statpage.h
+ *   merge    -- merge the trace shards in --shards into --trace by time
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments, argv[0] being the program name
+ * @return 0 on success, -1 on invalid settings or simulation error
+ */
+static int run_cli(int argc, char* argv[]) {
+  scenario_t sc;
+  sim_result_t res;
+  cli_t cli;
+
+  if (parse_settings(argc, argv, &sc, &cli))
+    return -1;
+
+  if (strcmp(cli.mode, "decode") == 0)
+    return decode_trace(sc.trace, sc.arrow);
+  if (strcmp(cli.mode, "analytic") == 0)
+    return run_analytic(&sc);
+  if (strcmp(cli.mode, "sweep") == 0)
+    return run_sweep(&sc, &cli);
+  if (strcmp(cli.mode, "rare") == 0)
+    return run_rare(&sc, &cli);
+  if (strcmp(cli.mode, "golden") == 0)
+    return run_golden(&cli);
+  if (strcmp(cli.mode, "bench") == 0)
+    return run_bench(&sc, &cli);
+  if (strcmp(cli.mode, "stress") == 0 || strcmp(cli.mode, "diff") == 0)
+    return run_replays(&sc, &cli);
+  if (strcmp(cli.mode, "monitor") == 0)
+    return run_monitor(&cli);
+  if (strcmp(cli.mode, "merge") == 0)
+    return run_merge(&sc, &cli);
+  if (strcmp(cli.mode, "morris") == 0 || strcmp(cli.mode, "sobol") == 0)
+    return run_sensitivity(&sc, &cli, strcmp(cli.mode, "sobol") == 0);
+  if (strcmp(cli.mode, "serve") == 0)
+    return server_run(&sc, cli.socket, cli.sens.threads);
+  if (strcmp(cli.mode, "run") != 0) {
+    fprintf(stderr, "Error, unknown mode '%s'\n", cli.mode);
+    return -1;
+  }
+
+  if (des_run(&sc, &res))
+    return -1;
+  result_print(stdout, &sc, &res);
+  return cli.results[0] ? write_results(cli.results, &sc, &res, NULL, 1) : 0;
+}
+
 /************************* MAIN ****************************/
 
-/* Runs the ledyard program. Arguments are unused
+/* Runs the ledyard program. Without arguments, the interactive threaded
+ * simulation runs; with settings such as "--cars 5000 --incident
+ * close@10m+5m", the discrete-event engine runs that scenario instead
  *
+ * @param argc the number of arguments
+ * @param argv the arguments
  * @return 0 on successful simulation, -1 on any error
  */
-int main(void) {
+int main(int argc, char* argv[]) {
+  if (argc > 1)
+    return run_cli(argc, argv);
+
   // initialize the ledyard bridge
   if (initialize_bridge())
     return -1;
+  // publish its state for monitors if LEDYARD_STATUS names a page
+  const char* status = getenv("LEDYARD_STATUS");
+  if (status != NULL && (ledyard.status = statpage_create(status)) == NULL)
+    return -1;
 
   // run and manage simulations based on user input
   manage_sims();
   
+  if (ledyard.status)
+    statpage_close(ledyard.status);
   // destroy ledyard mutex and cond variables
   // and exit with its return value
   return destroy_bridge();
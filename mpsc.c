@@ -0,0 +1,48 @@
+/* Purpose: Lock-free multi-producer, single-consumer queue */
+
+#include <stddef.h> // for NULL
+#include "mpsc.h"
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+void mpsc_init(mpsc_t* q) {
+  atomic_init(&q->stub.next, NULL);
+  atomic_init(&q->back, &q->stub);
+  q->front = &q->stub;
+}
+
+void mpsc_push(mpsc_t* q, mpsc_node_t* node) {
+  atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+  mpsc_node_t* prev = atomic_exchange_explicit(&q->back, node, memory_order_acq_rel);
+  // until this store the consumer cannot reach node, and sees an empty queue
+  atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+mpsc_node_t* mpsc_pop(mpsc_t* q) {
+  mpsc_node_t* front = q->front;
+  mpsc_node_t* next = atomic_load_explicit(&front->next, memory_order_acquire);
+
+  // step over the stub if it is at the front
+  if (front == &q->stub) {
+    if (next == NULL)
+      return NULL;
+    q->front = front = next;
+    next = atomic_load_explicit(&front->next, memory_order_acquire);
+  }
+  if (next != NULL) {
+    q->front = next;
+    return front;
+  }
+
+  // front is the last node linked; it can only be popped once the stub
+  // is queued behind it, unless a push has swapped back but not linked
+  if (front != atomic_load_explicit(&q->back, memory_order_acquire))
+    return NULL;
+  mpsc_push(q, &q->stub);
+  next = atomic_load_explicit(&front->next, memory_order_acquire);
+  if (next != NULL) {
+    q->front = next;
+    return front;
+  }
+  return NULL;
+}
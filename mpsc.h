@@ -0,0 +1,51 @@
+/* Purpose: A lock-free multi-producer, single-consumer queue (Dmitry
+ * Vyukov's intrusive MPSC queue). Producers push with one atomic exchange
+ * and never wait for each other or for the consumer; the single consumer
+ * pops in push order.
+ *
+ * The queue is intrusive: the caller embeds an mpsc_node_t in whatever it
+ * queues, and keeps it alive until it has been popped. A pop may return
+ * NULL while a push is halfway done (between its exchange and its link),
+ * so a consumer that sleeps when the queue looks empty must be woken by
+ * the producer after its push, as the bridge controller is.
+ */
+
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stdatomic.h>
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for the link embedded in a queued item
+typedef struct mpsc_node {
+  _Atomic(struct mpsc_node*) next;
+} mpsc_node_t;
+
+// define a data structure for the queue
+typedef struct mpsc {
+  _Atomic(mpsc_node_t*) back; // last node pushed; producers swap it
+  mpsc_node_t* front;         // next node to pop; only the consumer uses it
+  mpsc_node_t stub;           // keeps the queue non-empty between items
+} mpsc_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Initializes an empty queue */
+void mpsc_init(mpsc_t* q);
+
+/* Pushes a node; safe from any number of threads at once
+ *
+ * @param q the queue
+ * @param node the node, which must stay valid until popped
+ */
+void mpsc_push(mpsc_t* q, mpsc_node_t* node);
+
+/* Pops the oldest node; only one thread may pop
+ *
+ * @param q the queue
+ * @return the node, or NULL if the queue is empty or a push is under way
+ */
+mpsc_node_t* mpsc_pop(mpsc_t* q);
+
+#endif // MPSC_H
@@ -0,0 +1,127 @@
+/* Purpose: Buffered writer for the human-readable bridge messages */
+
+#define _POSIX_C_SOURCE 200809L // for fileno()
+
+#include <stdio.h>
+#include <stdlib.h>  // for malloc()
+#include <errno.h>   // for EINTR
+#include <unistd.h>  // for write(), isatty()
+#include <sys/uio.h> // for writev()
+#include "outbuf.h"
+#include "scenario.h" // for dir_name()
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Writes every byte described by iov, retrying short writes
+ *
+ * @return 0 on success, -1 on write error
+ */
+static int write_all(int fd, struct iovec* iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t n = writev(fd, iov, iovcnt);
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    // skip the fully written chunks, then trim the partly written one
+    while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char*) iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int outbuf_init(outbuf_t* ob, int fd, size_t cap) {
+  ob->cap = cap ? cap : OUTBUF_SIZE;
+  ob->buf = (char*) malloc(ob->cap);
+  if (ob->buf == NULL) {
+    fprintf(stderr, "Error allocating output buffer\n");
+    return -1;
+  }
+  ob->fd = fd;
+  ob->len = 0;
+  ob->line_flush = isatty(fd);
+  ob->error = 0;
+  return 0;
+}
+
+int outbuf_destroy(outbuf_t* ob) {
+  int rc = outbuf_flush(ob);
+  free(ob->buf);
+  ob->buf = NULL;
+  return rc || ob->error ? -1 : 0;
+}
+
+int outbuf_flush_with(outbuf_t* ob, const char* extra, size_t extra_len) {
+  struct iovec iov[2];
+  int iovcnt = 0;
+
+  if (ob->len == 0 && extra_len == 0)
+    return 0;
+  if (ob->fd == fileno(stdout))
+    fflush(stdout);
+
+  if (ob->len > 0) {
+    iov[iovcnt].iov_base = ob->buf;
+    iov[iovcnt++].iov_len = ob->len;
+  }
+  if (extra_len > 0) {
+    iov[iovcnt].iov_base = (void*) extra;
+    iov[iovcnt++].iov_len = extra_len;
+  }
+  ob->len = 0;
+
+  if (write_all(ob->fd, iov, iovcnt)) {
+    if (!ob->error)
+      perror("Error writing simulation output");
+    ob->error = 1;
+    return -1;
+  }
+  return 0;
+}
+
+/*********************** BRIDGE MESSAGES ***********************/
+
+void outbuf_arrive(outbuf_t* ob, int dir) {
+  outbuf_lit(ob, "A new car is waiting to go to ");
+  outbuf_str(ob, dir_name(dir));
+  outbuf_lit(ob, "\n");
+  outbuf_end_message(ob);
+}
+
+void outbuf_board(outbuf_t* ob, int dir) {
+  outbuf_lit(ob, "+++ A car got on bridge to ");
+  outbuf_str(ob, dir_name(dir));
+  outbuf_lit(ob, " +++\n");
+  outbuf_end_message(ob);
+}
+
+void outbuf_bridge(outbuf_t* ob, int num_cars, const char* str_dir,
+		   int wait_hanover, int wait_norwich) {
+  outbuf_lit(ob, "\n====== Ledyard Bridge ======\nFlow of Traffic: ");
+  outbuf_int(ob, num_cars);
+  outbuf_lit(ob, " cars to ");
+  outbuf_str(ob, str_dir);
+  outbuf_lit(ob, "\nCars waiting for Hanover: ");
+  outbuf_int(ob, wait_hanover);
+  outbuf_lit(ob, "\nCars waiting for Norwich: ");
+  outbuf_int(ob, wait_norwich);
+  outbuf_lit(ob, "\n\n");
+  outbuf_end_message(ob);
+}
+
+void outbuf_exit(outbuf_t* ob, int dir) {
+  outbuf_lit(ob, "--- A car has exited for ");
+  outbuf_str(ob, dir_name(dir));
+  outbuf_lit(ob, " ---\n");
+  outbuf_end_message(ob);
+}
@@ -0,0 +1,127 @@
+/* Purpose: A buffered writer for the human-readable bridge messages.
+ *
+ * Every message in the simulation used to be its own printf() call, and
+ * each printf() parses its format string and takes the stdio lock. The
+ * writer instead appends to one large buffer with hand-rolled integer
+ * formatting and hands the whole buffer to write()/writev() at once.
+ *
+ * A writer is not locked: each simulation owns its own (the threaded sim
+ * only touches its writer while holding ledyard.lock, which also keeps
+ * messages in the order events happened), so concurrent runs on separate
+ * threads never contend on output.
+ */
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h>
+#include <string.h> // for memcpy()
+
+#define OUTBUF_SIZE (256 * 1024) // default buffer size, in bytes
+#define OUTBUF_INT_LEN 24        // enough digits for any 64-bit integer
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for a buffered writer on a file descriptor
+typedef struct outbuf {
+  int fd;          // where buffered bytes are written
+  char* buf;       // pending bytes
+  size_t len;      // number of pending bytes
+  size_t cap;      // size of buf
+  int line_flush;  // nonzero to flush after every message (terminals)
+  int error;       // nonzero once a write has failed
+} outbuf_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Initializes a writer. Writers on a terminal flush after every message
+ * so interactive runs still show cars as they move
+ *
+ * @param ob the writer to initialize
+ * @param fd the file descriptor to write to
+ * @param cap the buffer size in bytes (0 for OUTBUF_SIZE)
+ * @return 0 on success, -1 on allocation error
+ */
+int outbuf_init(outbuf_t* ob, int fd, size_t cap);
+
+/* Flushes and frees a writer
+ *
+ * @return 0 on success, -1 if any write failed
+ */
+int outbuf_destroy(outbuf_t* ob);
+
+/* Writes all pending bytes, plus an optional extra chunk in the same
+ * writev() call. Pending stdio output is flushed first when writing to
+ * stdout so banners printed with printf() stay in order
+ *
+ * @param ob the writer
+ * @param extra bytes to write after the pending ones, or NULL
+ * @param extra_len the number of extra bytes
+ * @return 0 on success, -1 on write error
+ */
+int outbuf_flush_with(outbuf_t* ob, const char* extra, size_t extra_len);
+
+/* Writes all pending bytes
+ *
+ * @return 0 on success, -1 on write error
+ */
+static inline int outbuf_flush(outbuf_t* ob) {
+  return outbuf_flush_with(ob, NULL, 0);
+}
+
+/* Appends bytes, flushing first if they do not fit */
+static inline void outbuf_put(outbuf_t* ob, const char* s, size_t n) {
+  if (ob->len + n > ob->cap) {
+    outbuf_flush_with(ob, s, n);
+    return;
+  }
+  memcpy(ob->buf + ob->len, s, n);
+  ob->len += n;
+}
+
+/* Appends a string literal without measuring it at run time */
+#define outbuf_lit(ob, lit) outbuf_put((ob), (lit), sizeof(lit) - 1)
+
+/* Appends a NUL-terminated string */
+static inline void outbuf_str(outbuf_t* ob, const char* s) {
+  outbuf_put(ob, s, strlen(s));
+}
+
+/* Appends a signed integer in decimal */
+static inline void outbuf_int(outbuf_t* ob, long long v) {
+  char digits[OUTBUF_INT_LEN];
+  char* p = digits + sizeof(digits);
+  unsigned long long u = v < 0 ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+  do {
+    *--p = (char) ('0' + u % 10);
+    u /= 10;
+  } while (u);
+  if (v < 0)
+    *--p = '-';
+  outbuf_put(ob, p, digits + sizeof(digits) - p);
+}
+
+/* Marks the end of one message, flushing if the writer is line-flushed */
+static inline void outbuf_end_message(outbuf_t* ob) {
+  if (ob->line_flush)
+    outbuf_flush(ob);
+}
+
+/*********************** BRIDGE MESSAGES ***********************/
+
+/* The messages below match the threaded sim's original printf() formats */
+
+/* "A new car is waiting to go to <town>" */
+void outbuf_arrive(outbuf_t* ob, int dir);
+
+/* "+++ A car got on bridge to <town> +++" */
+void outbuf_board(outbuf_t* ob, int dir);
+
+/* The "====== Ledyard Bridge ======" block printed by on_bridge() */
+void outbuf_bridge(outbuf_t* ob, int num_cars, const char* str_dir,
+		   int wait_hanover, int wait_norwich);
+
+/* "--- A car has exited for <town> ---" */
+void outbuf_exit(outbuf_t* ob, int dir);
+
+#endif // OUTBUF_H
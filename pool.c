@@ -0,0 +1,79 @@
+/* Purpose: A thread pool running independent discrete-event simulations */
+
+#define _POSIX_C_SOURCE 200809L // for sysconf()
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdatomic.h> // for atomic_fetch_add()
+#include <unistd.h>    // for sysconf()
+#include "pool.h"
+#include "des.h"
+
+#define MAX_THREADS 256
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure shared by a pool's workers
+typedef struct pool_job {
+  const scenario_t* scs;  // the scenarios to run
+  sim_result_t* results;  // where their metrics go
+  int n;                  // the number of scenarios
+  atomic_int next;        // index of the next unclaimed scenario
+  atomic_int failed;      // nonzero once any run failed
+} pool_job_t;
+
+/*********************** THREAD-INVOKED FUNCTIONS ***********************/
+
+/* Claims and runs scenarios until none are left
+ *
+ * @param vargp a void* pointing to the shared pool_job_t
+ * @return NULL
+ */
+static void* worker(void* vargp) {
+  pool_job_t* job = vargp;
+  int i;
+  while ((i = atomic_fetch_add(&job->next, 1)) < job->n) {
+    if (des_run(&job->scs[i], &job->results[i]))
+      atomic_store(&job->failed, 1);
+  }
+  return NULL;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int pool_default_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : (int) n;
+}
+
+int pool_run(const scenario_t* scs, sim_result_t* results, int n, int threads) {
+  pthread_t tids[MAX_THREADS];
+  pool_job_t job;
+  int i, started = 0;
+
+  job.scs = scs;
+  job.results = results;
+  job.n = n;
+  atomic_init(&job.next, 0);
+  atomic_init(&job.failed, 0);
+
+  if (threads > MAX_THREADS)
+    threads = MAX_THREADS;
+  if (threads > n)
+    threads = n;
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&tids[i], NULL, worker, &job)) {
+      fprintf(stderr, "Error creating worker thread %d\n", i);
+      break;
+    }
+    started++;
+  }
+  if (started == 0 && n > 0)
+    worker(&job); // no threads at all; run everything here
+
+  for (i = 0; i < started; i++) {
+    if (pthread_join(tids[i], NULL))
+      fprintf(stderr, "Error waiting for worker thread %d to terminate\n", i);
+  }
+  return atomic_load(&job.failed) ? -1 : 0;
+}
@@ -0,0 +1,25 @@
+/* Purpose: Runs many independent scenarios on the discrete-event engine
+ * in parallel. Worker threads claim scenarios from a shared atomic index,
+ * so the only contention is one fetch-and-add per run, and results land
+ * in the caller's array in the scenarios' order.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "scenario.h"
+
+/* Returns the number of online processors, for a default thread count */
+int pool_default_threads(void);
+
+/* Runs every scenario and saves its metrics
+ *
+ * @param scs the scenarios to run
+ * @param results where to save each scenario's metrics, in order
+ * @param n the number of scenarios
+ * @param threads the number of worker threads (at least 1)
+ * @return 0 on success, -1 if any run or thread failed
+ */
+int pool_run(const scenario_t* scs, sim_result_t* results, int n, int threads);
+
+#endif // POOL_H
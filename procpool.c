@@ -0,0 +1,194 @@
+/* Purpose: A process pool running independent discrete-event simulations
+ * with results in shared memory and a watchdog for hung runs
+ */
+
+#define _DEFAULT_SOURCE // for MAP_ANONYMOUS, kill(), nanosleep()
+
+#include <stdio.h>
+#include <string.h>    // for memcpy()
+#include <stdatomic.h> // for atomic_fetch_add()
+#include <signal.h>    // for kill()
+#include <time.h>      // for clock_gettime()
+#include <unistd.h>    // for fork()
+#include <errno.h>     // for EINTR
+#include <sys/mman.h>  // for mmap()
+#include <sys/wait.h>  // for waitpid()
+#include "procpool.h"
+#include "des.h"
+
+#define MAX_PROCS 256
+#define NO_RUN -1
+#define POLL_NSEC 1000000 // how often the watchdog looks at the workers
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for what one worker process is doing
+typedef struct worker_slot {
+  atomic_int run;        // the run it is on, or NO_RUN
+  atomic_llong started;  // when that run started, in monotonic ns
+} worker_slot_t;
+
+// define a data structure for one scenario's run
+typedef struct run_slot {
+  atomic_int status;     // RUN_PENDING until the worker or watchdog decides
+  sim_result_t result;   // valid once status is RUN_DONE
+} run_slot_t;
+
+// define a data structure for the memory shared by the parent and workers
+typedef struct shared {
+  atomic_int next;       // index of the next unclaimed scenario
+  worker_slot_t workers[MAX_PROCS];
+  run_slot_t runs[];     // one per scenario
+} shared_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Returns the monotonic clock in nanoseconds */
+static long long now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/* Settles a run's outcome unless it is already settled
+ *
+ * @return nonzero if this call settled it
+ */
+static int settle(run_slot_t* run, int status) {
+  int pending = RUN_PENDING;
+  return atomic_compare_exchange_strong(&run->status, &pending, status);
+}
+
+/* Claims and runs scenarios until none are left, then exits; runs in a
+ * worker process
+ *
+ * @param sh the shared memory
+ * @param scs the scenarios, inherited from the parent
+ * @param n the number of scenarios
+ * @param w the worker's slot
+ */
+static void work(shared_t* sh, const scenario_t* scs, int n, int w) {
+  worker_slot_t* me = &sh->workers[w];
+  sim_result_t res;
+  int i;
+  while ((i = atomic_fetch_add(&sh->next, 1)) < n) {
+    atomic_store(&me->started, now_ns());
+    atomic_store(&me->run, i);
+    if (des_run(&scs[i], &res))
+      settle(&sh->runs[i], RUN_FAILED);
+    else {
+      sh->runs[i].result = res; // ignored unless this worker settles it
+      settle(&sh->runs[i], RUN_DONE);
+    }
+    atomic_store(&me->run, NO_RUN);
+  }
+  fflush(stdout); // _exit() discards what a run printed, such as hourly tables
+  _exit(0);
+}
+
+/* Forks a worker process for a slot
+ *
+ * @return the worker's pid, or -1 on error
+ */
+static pid_t spawn(shared_t* sh, const scenario_t* scs, int n, int w) {
+  atomic_store(&sh->workers[w].run, NO_RUN);
+  pid_t pid = fork();
+  if (pid == 0)
+    work(sh, scs, n, w);
+  if (pid < 0)
+    fprintf(stderr, "Error forking worker process %d\n", w);
+  return pid;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int procpool_run(const scenario_t* scs, sim_result_t* results, int* status, int n, int procs,
+		 sim_time_t timeout) {
+  pid_t pids[MAX_PROCS];
+  int i, w, alive = 0, rc = 0;
+
+  if (n <= 0)
+    return 0;
+  if (procs > MAX_PROCS)
+    procs = MAX_PROCS;
+  if (procs > n)
+    procs = n;
+
+  size_t size = sizeof(shared_t) + (size_t) n * sizeof(run_slot_t);
+  shared_t* sh = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (sh == MAP_FAILED) {
+    fprintf(stderr, "Error mapping shared memory for %d runs\n", n);
+    return -1;
+  }
+  atomic_init(&sh->next, 0);
+  for (i = 0; i < n; i++)
+    atomic_init(&sh->runs[i].status, RUN_PENDING);
+
+  fflush(stdout); // or the children would repeat the parent's buffered output
+  fflush(stderr);
+  for (w = 0; w < procs; w++) {
+    if ((pids[w] = spawn(sh, scs, n, w)) > 0)
+      alive++;
+  }
+
+  while (alive > 0) {
+    int wstatus;
+    pid_t pid = waitpid(-1, &wstatus, timeout ? WNOHANG : 0);
+    if (pid < 0 && errno != EINTR) {
+      fprintf(stderr, "Error waiting for worker processes\n");
+      rc = -1;
+      break;
+    }
+
+    if (pid > 0) {
+      for (w = 0; w < procs && pids[w] != pid; w++)
+	;
+      if (w == procs)
+	continue;
+      alive--;
+      pids[w] = -1;
+      // a run the worker died in is failed, unless the watchdog already
+      // marked it hung
+      int run = atomic_load(&sh->workers[w].run);
+      if (run != NO_RUN && settle(&sh->runs[run], RUN_FAILED))
+	fprintf(stderr, "Error, worker process died during run %d\n", run);
+      int crashed = !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0;
+      if (crashed && atomic_load(&sh->next) < n && (pids[w] = spawn(sh, scs, n, w)) > 0)
+	alive++;
+      continue;
+    }
+
+    // the watchdog: kill workers stuck on one run for too long
+    long long now = now_ns();
+    for (w = 0; w < procs; w++) {
+      if (pids[w] <= 0)
+	continue;
+      int run = atomic_load(&sh->workers[w].run);
+      if (run == NO_RUN || now - atomic_load(&sh->workers[w].started) <= timeout * 1000LL)
+	continue;
+      if (settle(&sh->runs[run], RUN_HUNG)) {
+	fprintf(stderr, "Error, run %d took longer than %.0fms; killing its worker\n", run,
+		(double) timeout * 1000 / SIM_SEC);
+	kill(pids[w], SIGKILL);
+      }
+    }
+    struct timespec poll = { 0, POLL_NSEC };
+    nanosleep(&poll, NULL);
+  }
+
+  for (i = 0; i < n; i++) {
+    int st = atomic_load(&sh->runs[i].status);
+    if (st == RUN_PENDING)
+      st = RUN_FAILED; // claimed by a worker that died before saying so
+    if (st == RUN_DONE)
+      memcpy(&results[i], &sh->runs[i].result, sizeof(sim_result_t));
+    else {
+      memset(&results[i], 0, sizeof(sim_result_t));
+      rc = -1;
+    }
+    if (status)
+      status[i] = st;
+  }
+  munmap(sh, size);
+  return rc;
+}
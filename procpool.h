@@ -0,0 +1,43 @@
+/* Purpose: Runs many independent scenarios on the discrete-event engine
+ * in worker processes instead of threads, so that one run that hangs or
+ * crashes cannot take the whole batch with it.
+ *
+ * The workers are forked children that share one anonymous memory
+ * mapping with the parent: an atomic index that hands out scenarios, a
+ * slot per worker saying which run it is on and since when, and one
+ * fixed-size result record per scenario. Workers write their results
+ * straight into the mapping, so nothing is copied through pipes or files.
+ * The parent is the watchdog: it kills a worker whose run exceeds the
+ * timeout, marks that run as hung and forks a replacement, which carries
+ * on with the remaining scenarios.
+ */
+
+#ifndef PROCPOOL_H
+#define PROCPOOL_H
+
+#include "scenario.h"
+
+// outcome of each run
+#define RUN_PENDING 0 // not finished (only seen while running)
+#define RUN_DONE 1    // finished; its result is valid
+#define RUN_FAILED 2  // the engine returned an error or the worker crashed
+#define RUN_HUNG 3    // killed by the watchdog after the timeout
+
+/*************************** FUNCTIONS **************************/
+
+/* Runs every scenario in worker processes and saves its metrics
+ *
+ * @param scs the scenarios to run
+ * @param results where to save each scenario's metrics, in order
+ * @param status where to save each run's RUN_ outcome, or NULL
+ * @param n the number of scenarios
+ * @param procs the number of worker processes (at least 1)
+ * @param timeout the longest a run may take in real time before it is
+ *        killed (0 = no limit)
+ * @return 0 if every run finished, -1 if any failed or hung, or on error
+ *         setting up the workers
+ */
+int procpool_run(const scenario_t* scs, sim_result_t* results, int* status, int n, int procs,
+		 sim_time_t timeout);
+
+#endif // PROCPOOL_H
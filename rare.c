@@ -0,0 +1,162 @@
+/* Purpose: Cross-entropy importance sampling of long waits */
+
+#include <stdio.h>
+#include <stdlib.h> // for malloc(), qsort()
+#include <string.h> // for memset()
+#include <math.h>   // for exp(), sqrt()
+#include "rare.h"
+#include "des.h"
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for what a cross-entropy round keeps per run
+typedef struct ce_run {
+  sim_time_t level;  // longest wait in the run
+  double log_lr;     // log likelihood ratio of the run's arrivals
+  uint64_t arrived[NUM_DIRECTIONS]; // arrivals towards each town
+} ce_run_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Orders runs by descending longest wait, for qsort() */
+static int by_level_desc(const void* a, const void* b) {
+  sim_time_t la = ((const ce_run_t*) a)->level;
+  sim_time_t lb = ((const ce_run_t*) b)->level;
+  return (la < lb) - (la > lb);
+}
+
+/* Runs one simulation at the tilted rates with a fresh seed
+ *
+ * @return 0 on success, -1 on simulation error
+ */
+static int tilted_run(const scenario_t* sc, des_tilt_t* tilt, uint64_t* next_seed,
+		      sim_result_t* res, rare_result_t* out) {
+  scenario_t run = *sc;
+  run.seed = (*next_seed)++;
+  if (des_run_tilted(&run, res, tilt))
+    return -1;
+  out->cars += res->arrived[TO_HANOVER] + res->arrived[TO_NORWICH];
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+void rare_defaults(rare_opts_t* opts) {
+  opts->threshold = 30 * SIM_MIN;
+  opts->ce_runs = 200;
+  opts->elite = 0.1;
+  opts->max_levels = 30;
+  opts->runs = 1000;
+}
+
+int rare_estimate(const scenario_t* sc, const rare_opts_t* opts, rare_result_t* out) {
+  des_tilt_t tilt;
+  sim_result_t res;
+  uint64_t next_seed = sc->seed;
+  double minutes = (double) sc->horizon / SIM_MIN;
+  int i, d, level;
+
+  memset(out, 0, sizeof(*out));
+  memset(&tilt, 0, sizeof(tilt));
+  tilt.threshold = opts->threshold;
+  for (d = 0; d < NUM_DIRECTIONS; d++)
+    tilt.rate[d] = sc->rate[d];
+
+  ce_run_t* runs = (ce_run_t*) malloc(opts->ce_runs * sizeof(ce_run_t));
+  if (runs == NULL) {
+    fprintf(stderr, "Error allocating cross-entropy runs\n");
+    return -1;
+  }
+
+  /************** Cross-entropy rounds ****************/
+  double elite = opts->elite;
+  sim_time_t last_gamma = -1;
+  for (level = 0; level < opts->max_levels && !out->reached; level++) {
+    for (i = 0; i < opts->ce_runs; i++) {
+      if (tilted_run(sc, &tilt, &next_seed, &res, out)) {
+	free(runs);
+	return -1;
+      }
+      runs[i].level = res.wait_max;
+      runs[i].log_lr = tilt.log_lr;
+      for (d = 0; d < NUM_DIRECTIONS; d++)
+	runs[i].arrived[d] = res.arrived[d];
+    }
+
+    // the round's level is the elite quantile of the longest waits,
+    // capped at the threshold; ties with the quantile stay elite
+    qsort(runs, opts->ce_runs, sizeof(ce_run_t), by_level_desc);
+    int num_elite = (int) (elite * opts->ce_runs);
+    if (num_elite < 1)
+      num_elite = 1;
+    sim_time_t gamma = runs[num_elite - 1].level;
+    if (gamma >= opts->threshold) {
+      gamma = opts->threshold;
+      out->reached = 1;
+    }
+    else if (gamma <= last_gamma) {
+      // the level stalled; a smaller elite pushes the next one higher
+      elite /= 2;
+      gamma = last_gamma;
+      num_elite = (int) (elite * opts->ce_runs);
+      if (num_elite < 1)
+	num_elite = 1;
+      if (runs[num_elite - 1].level > gamma)
+	gamma = runs[num_elite - 1].level;
+    }
+    last_gamma = gamma;
+    while (num_elite < opts->ce_runs && runs[num_elite].level >= gamma)
+      num_elite++;
+
+    // weighted maximum likelihood rates of the elite runs; weights are
+    // scaled by the largest so exp() cannot overflow
+    double max_lr = runs[0].log_lr, weight_sum = 0, count[NUM_DIRECTIONS] = { 0, 0 };
+    for (i = 1; i < num_elite; i++) {
+      if (runs[i].log_lr > max_lr)
+	max_lr = runs[i].log_lr;
+    }
+    for (i = 0; i < num_elite; i++) {
+      double w = exp(runs[i].log_lr - max_lr);
+      weight_sum += w;
+      for (d = 0; d < NUM_DIRECTIONS; d++)
+	count[d] += w * runs[i].arrived[d];
+    }
+    for (d = 0; d < NUM_DIRECTIONS; d++) {
+      if (sc->rate[d] > 0 && count[d] > 0)
+	tilt.rate[d] = count[d] / (weight_sum * minutes);
+    }
+  }
+  out->levels = level;
+  free(runs);
+
+  /************** Final importance-sampled runs ****************/
+  double sum_car = 0, sumsq_car = 0, sum_run = 0, sumsq_run = 0;
+  for (i = 0; i < opts->runs; i++) {
+    if (tilted_run(sc, &tilt, &next_seed, &res, out))
+      return -1;
+    double run_hit = res.wait_max > opts->threshold ? exp(tilt.log_lr) : 0.0;
+    sum_car += tilt.weighted_hits;
+    sumsq_car += tilt.weighted_hits * tilt.weighted_hits;
+    sum_run += run_hit;
+    sumsq_run += run_hit * run_hit;
+    out->hits += tilt.hits;
+  }
+
+  // per-car probability: expected weighted hits per run over the expected
+  // cars per run at the scenario's own rates
+  double n = opts->runs;
+  double cars_per_run = (sc->rate[TO_HANOVER] + sc->rate[TO_NORWICH]) * minutes;
+  double mean_car = sum_car / n, mean_run = sum_run / n;
+  double var_car = n > 1 ? (sumsq_car - n * mean_car * mean_car) / (n - 1) : 0.0;
+  double var_run = n > 1 ? (sumsq_run - n * mean_run * mean_run) / (n - 1) : 0.0;
+
+  out->p_car = mean_car / cars_per_run;
+  out->re_car = mean_car > 0 ? sqrt(var_car > 0 ? var_car / n : 0.0) / mean_car : INFINITY;
+  out->p_run = mean_run;
+  out->re_run = mean_run > 0 ? sqrt(var_run > 0 ? var_run / n : 0.0) / mean_run : INFINITY;
+  for (d = 0; d < NUM_DIRECTIONS; d++)
+    out->rate[d] = tilt.rate[d];
+  if (out->p_car > 0 && out->re_car > 0 && isfinite(out->re_car))
+    out->plain_cars = (1 - out->p_car) / (out->p_car * out->re_car * out->re_car);
+  return 0;
+}
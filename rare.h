@@ -0,0 +1,61 @@
+/* Purpose: Estimates the probability that a car waits longer than some
+ * threshold (say 30 minutes), an event plain simulation almost never
+ * observes at realistic loads.
+ *
+ * Cross-entropy importance sampling over the arrival process: a few
+ * rounds of runs at tilted arrival rates raise a level (the longest wait
+ * in a run) step by step until the threshold is reached, updating the
+ * rates from the weighted elite runs each round. Final runs at the chosen
+ * rates then count every car waiting past the threshold, weighted by the
+ * likelihood ratio of the arrivals that led up to its boarding.
+ */
+
+#ifndef RARE_H
+#define RARE_H
+
+#include <stdint.h>
+#include "scenario.h"
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for how to run an estimate
+typedef struct rare_opts {
+  sim_time_t threshold; // waits longer than this are the rare event
+  int ce_runs;          // runs per cross-entropy round
+  double elite;         // fraction of each round's runs kept as elite
+  int max_levels;       // most cross-entropy rounds before giving up
+  int runs;             // runs for the final estimate
+} rare_opts_t;
+
+// define a data structure for the estimate
+typedef struct rare_result {
+  double p_car;     // probability a car waits longer than the threshold
+  double re_car;    // relative standard error of p_car
+  double p_run;     // probability some car in a run waits that long
+  double re_run;    // relative standard error of p_run
+  double rate[NUM_DIRECTIONS]; // tilted arrival rates used, cars/min
+  int levels;       // cross-entropy rounds taken
+  int reached;      // nonzero if the rounds reached the threshold
+  uint64_t cars;    // cars simulated, over all rounds and final runs
+  uint64_t hits;    // cars seen waiting past the threshold in final runs
+  double plain_cars; // cars plain simulation would need for the same
+                     // relative error
+} rare_result_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Fills estimate options with defaults: a 30 minute threshold, 200 runs
+ * per round keeping the top 10%, up to 30 rounds, and 1000 final runs
+ */
+void rare_defaults(rare_opts_t* opts);
+
+/* Estimates the probability of a wait longer than opts->threshold
+ *
+ * @param sc the scenario; must be limited by its horizon only
+ * @param opts how to run the estimate
+ * @param out where to save the estimate
+ * @return 0 on success, -1 on simulation error
+ */
+int rare_estimate(const scenario_t* sc, const rare_opts_t* opts, rare_result_t* out);
+
+#endif // RARE_H
@@ -0,0 +1,73 @@
+/* Purpose: A small seeded random number generator (xoshiro256**) so that
+ * every simulated run can be reproduced exactly from its seed, unlike
+ * the global rand() used to encourage interleavings in the threaded sim
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include <math.h> // for log()
+
+// define a data structure for one independent random stream
+typedef struct rng {
+  uint64_t s[4];
+} rng_t;
+
+/* Advances a splitmix64 state, used to expand a seed into a full state
+ *
+ * @param x the splitmix64 state to advance
+ * @return the next 64 random bits
+ */
+static inline uint64_t rng_splitmix(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* Seeds a random stream; equal seeds give equal streams
+ *
+ * @param r the stream to seed
+ * @param seed any 64-bit value
+ */
+static inline void rng_seed(rng_t* r, uint64_t seed) {
+  int i;
+  for (i = 0; i < 4; i++)
+    r->s[i] = rng_splitmix(&seed);
+}
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+/* Returns the next 64 random bits of a stream */
+static inline uint64_t rng_next(rng_t* r) {
+  uint64_t* s = r->s;
+  uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 45);
+  return result;
+}
+
+/* Returns a uniform double in [0, 1) */
+static inline double rng_uniform(rng_t* r) {
+  return (double) (rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Returns an exponentially distributed double with the given mean */
+static inline double rng_exponential(rng_t* r, double mean) {
+  return -mean * log(1.0 - rng_uniform(r));
+}
+
+/* Returns a uniform integer in [min, max], INCLUSIVE */
+static inline int64_t rng_range(rng_t* r, int64_t min, int64_t max) {
+  return min + (int64_t) (rng_uniform(r) * (double) (max - min + 1));
+}
+
+#endif // RNG_H
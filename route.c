@@ -0,0 +1,37 @@
+/* Purpose: Route choice against a lock-free snapshot of the lobbies */
+
+#include "route.h"
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+void route_init(route_snapshot_t* snap) {
+  atomic_init(&snap->seq, 0);
+  atomic_init(&snap->waiting[TO_HANOVER], 0);
+  atomic_init(&snap->waiting[TO_NORWICH], 0);
+}
+
+void route_publish(route_snapshot_t* snap, const int waiting[NUM_DIRECTIONS]) {
+  unsigned seq = atomic_load_explicit(&snap->seq, memory_order_relaxed);
+  atomic_store_explicit(&snap->seq, seq + 1, memory_order_relaxed);
+  // the odd sequence must be visible before any count changes
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&snap->waiting[TO_HANOVER], waiting[TO_HANOVER], memory_order_relaxed);
+  atomic_store_explicit(&snap->waiting[TO_NORWICH], waiting[TO_NORWICH], memory_order_relaxed);
+  atomic_store_explicit(&snap->seq, seq + 2, memory_order_release);
+}
+
+void route_read(route_snapshot_t* snap, int waiting[NUM_DIRECTIONS]) {
+  unsigned before, after;
+  do {
+    before = atomic_load_explicit(&snap->seq, memory_order_acquire);
+    waiting[TO_HANOVER] = atomic_load_explicit(&snap->waiting[TO_HANOVER], memory_order_relaxed);
+    waiting[TO_NORWICH] = atomic_load_explicit(&snap->waiting[TO_NORWICH], memory_order_relaxed);
+    // the counts must be read before the sequence is checked again
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&snap->seq, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+int route_detour(const scenario_t* sc, int waiting, double u) {
+  return sc->detour_queue > 0 && waiting >= sc->detour_queue && u < sc->detour_prob;
+}
@@ -0,0 +1,58 @@
+/* Purpose: Route choice between the Ledyard bridge and a detour (the
+ * Wilder or Route 10 bridges). An arriving driver looks at how many cars
+ * wait in their direction and, if the queue has reached the scenario's
+ * detour_queue, takes the detour with probability detour_prob.
+ *
+ * Drivers see the queue through a snapshot rather than the bridge state
+ * itself. In the threaded bridge the snapshot is a sequence lock: the
+ * thread holding the bridge lock publishes the lobby sizes whenever they
+ * change, and arriving cars read them without taking any lock, retrying
+ * only if they raced with a publish. Route choice therefore adds no
+ * contention on the bridge lock, at the price of a count that may be one
+ * update behind.
+ */
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <stdatomic.h>
+#include "scenario.h"
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for the lobby sizes published for route choice
+typedef struct route_snapshot {
+  atomic_uint seq;                      // odd while a publish is under way
+  atomic_int waiting[NUM_DIRECTIONS];   // cars waiting towards each town
+} route_snapshot_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Resets a snapshot to empty lobbies */
+void route_init(route_snapshot_t* snap);
+
+/* Publishes the lobby sizes. Only one thread may publish at a time; the
+ * threaded bridge publishes while holding its lock
+ *
+ * @param snap the snapshot
+ * @param waiting the cars waiting towards each town
+ */
+void route_publish(route_snapshot_t* snap, const int waiting[NUM_DIRECTIONS]);
+
+/* Reads a consistent copy of the lobby sizes without locking
+ *
+ * @param snap the snapshot
+ * @param waiting where to save the cars waiting towards each town
+ */
+void route_read(route_snapshot_t* snap, int waiting[NUM_DIRECTIONS]);
+
+/* Decides whether a driver takes the detour
+ *
+ * @param sc the scenario giving detour_queue and detour_prob
+ * @param waiting the cars the driver sees waiting in their direction
+ * @param u a uniform draw in [0, 1)
+ * @return nonzero to take the detour, 0 to queue for the bridge
+ */
+int route_detour(const scenario_t* sc, int waiting, double u);
+
+#endif // ROUTE_H
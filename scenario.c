@@ -0,0 +1,488 @@
+/* Purpose: Defaults, "key=value" parsing and result printing for the
+ * scenarios shared by the Ledyard Bridge simulators
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for strtod()
+#include <string.h> // for strcmp()
+#include <ctype.h>  // for isspace()
+#include <math.h>   // for sqrt()
+#include "scenario.h"
+#include "trace.h"  // for the trace formats
+
+#define KEY_LEN 64
+#define LINE_LEN 512
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Parses a long from text, rejecting trailing garbage
+ *
+ * @param text the number as text
+ * @param out where to save the parsed number
+ * @return 0 on success, -1 on invalid text
+ */
+static int parse_long(const char* text, long* out) {
+  char* extra = NULL;
+  long val = strtol(text, &extra, 10);
+  if (text[0] == '\0' || extra[0] != '\0')
+    return -1;
+  *out = val;
+  return 0;
+}
+
+/* Parses a double from text, rejecting trailing garbage
+ *
+ * @param text the number as text
+ * @param out where to save the parsed number
+ * @return 0 on success, -1 on invalid text
+ */
+static int parse_double(const char* text, double* out) {
+  char* extra = NULL;
+  double val = strtod(text, &extra);
+  if (text[0] == '\0' || extra[0] != '\0')
+    return -1;
+  *out = val;
+  return 0;
+}
+
+/* Parses a demand calendar: arrivals per minute for consecutive hours,
+ * separated by commas, such as "1,1,4.5,6,3"
+ *
+ * @param text the calendar as text
+ * @param rates where to save the hourly rates
+ * @param hours where to save the number of hours
+ * @return 0 on success, -1 on invalid text or too many hours
+ */
+static int parse_demand(const char* text, double rates[MAX_DEMAND_HOURS], int* hours) {
+  const char* p = text;
+  char* end;
+  int n = 0;
+  for (;;) {
+    if (n == MAX_DEMAND_HOURS)
+      return -1;
+    rates[n] = strtod(p, &end);
+    if (end == p || rates[n] < 0)
+      return -1;
+    n++;
+    if (*end == '\0')
+      break;
+    if (*end != ',')
+      return -1;
+    p = end + 1;
+  }
+  *hours = n;
+  return 0;
+}
+
+/* Parses a ramp meter such as "1.5" (cars per minute) or "1.5:4" (and
+ * up to 4 cars back to back after a quiet spell)
+ *
+ * @param text the meter as text
+ * @param rate where to save the rate
+ * @param burst where to save the burst
+ * @return 0 on success, -1 on invalid text
+ */
+static int parse_meter(const char* text, double* rate, int* burst) {
+  char* end;
+  long b = 1;
+  double r = strtod(text, &end);
+  if (end == text || r < 0)
+    return -1;
+  if (*end == ':') {
+    if (parse_long(end + 1, &b) || b < 1)
+      return -1;
+  }
+  else if (*end != '\0')
+    return -1;
+  *rate = r;
+  *burst = (int) b;
+  return 0;
+}
+
+/* Parses an incident such as "close@600+120" (closed for 120s starting
+ * at 600s) or "cap=1@10m+5m" (capacity 1 for 5 minutes from minute 10)
+ *
+ * @param text the incident as text
+ * @param inc where to save the parsed incident
+ * @return 0 on success, -1 on invalid text
+ */
+static int parse_incident(const char* text, incident_t* inc) {
+  char buf[KEY_LEN];
+  if (strlen(text) >= sizeof(buf))
+    return -1;
+  strcpy(buf, text);
+
+  char* at = strchr(buf, '@');
+  char* plus = at ? strchr(at, '+') : NULL;
+  if (at == NULL || plus == NULL)
+    return -1;
+  *at = '\0';
+  *plus = '\0';
+
+  long cap = 0;
+  if (strcmp(buf, "close") == 0) {
+    inc->type = INCIDENT_CLOSE;
+  }
+  else if (strncmp(buf, "cap=", 4) == 0 && parse_long(buf + 4, &cap) == 0 && cap >= 1) {
+    inc->type = INCIDENT_CAPACITY;
+  }
+  else
+    return -1;
+
+  inc->capacity = (int) cap;
+  if (parse_duration(at + 1, &inc->start) || parse_duration(plus + 1, &inc->duration))
+    return -1;
+  if (inc->start < 0 || inc->duration <= 0)
+    return -1;
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+const char* dir_name(int dir) {
+  if (dir == TO_HANOVER)
+    return "Hanover";
+  if (dir == TO_NORWICH)
+    return "Norwich";
+  return "Neither";
+}
+
+int parse_duration(const char* text, sim_time_t* out) {
+  char* unit = NULL;
+  double val = strtod(text, &unit);
+  double scale;
+
+  if (unit == text)
+    return -1;
+  if (strcmp(unit, "") == 0 || strcmp(unit, "s") == 0)
+    scale = SIM_SEC;
+  else if (strcmp(unit, "ms") == 0)
+    scale = SIM_SEC / 1000;
+  else if (strcmp(unit, "m") == 0)
+    scale = SIM_MIN;
+  else if (strcmp(unit, "h") == 0)
+    scale = SIM_HOUR;
+  else
+    return -1;
+
+  *out = (sim_time_t) llround(val * scale);
+  return 0;
+}
+
+void scenario_defaults(scenario_t* sc) {
+  memset(sc, 0, sizeof(*sc));
+  sc->seed = 1;
+  sc->cars = 1000;
+  sc->horizon = 0;
+  sc->capacity = MAX_CARS;
+  sc->rate[TO_HANOVER] = 2.0;
+  sc->rate[TO_NORWICH] = 2.0;
+  sc->cross_min = 20 * SIM_SEC;
+  sc->cross_max = 40 * SIM_SEC;
+  sc->switch_time = 10 * SIM_SEC;
+  sc->trace_format = TRACE_COMPACT;
+  sc->trace_sample = 1;
+  sc->meter_burst[TO_HANOVER] = sc->meter_burst[TO_NORWICH] = 1;
+  sc->detour_prob = 0.5;
+}
+
+void scenario_quiet(scenario_t* sc) {
+  sc->verbose = 0;
+  sc->trace[0] = '\0';
+  sc->arrow[0] = '\0';
+  sc->window_report = 0;
+  sc->hourly = 0;
+  sc->steady = 0;
+}
+
+int scenario_set(scenario_t* sc, const char* key, const char* value) {
+  char name[KEY_LEN];
+  long lval;
+  double dval;
+  sim_time_t tval;
+  size_t i;
+
+  if (strlen(key) >= sizeof(name))
+    return -1;
+  for (i = 0; key[i] != '\0'; i++)
+    name[i] = key[i] == '-' ? '_' : key[i];
+  name[i] = '\0';
+
+  if (strcmp(name, "seed") == 0 && parse_long(value, &lval) == 0) {
+    sc->seed = (uint64_t) lval;
+  }
+  else if (strcmp(name, "cars") == 0 && parse_long(value, &lval) == 0 && lval >= 0) {
+    sc->cars = lval;
+  }
+  else if (strcmp(name, "horizon") == 0 && parse_duration(value, &tval) == 0 && tval >= 0) {
+    sc->horizon = tval;
+  }
+  else if (strcmp(name, "capacity") == 0 && parse_long(value, &lval) == 0 && lval >= 1) {
+    sc->capacity = (int) lval;
+  }
+  else if (strcmp(name, "rate_hanover") == 0 && parse_double(value, &dval) == 0 && dval >= 0) {
+    sc->rate[TO_HANOVER] = dval;
+  }
+  else if (strcmp(name, "rate_norwich") == 0 && parse_double(value, &dval) == 0 && dval >= 0) {
+    sc->rate[TO_NORWICH] = dval;
+  }
+  else if (strcmp(name, "cross_min") == 0 && parse_duration(value, &tval) == 0 && tval > 0) {
+    sc->cross_min = tval;
+  }
+  else if (strcmp(name, "cross_max") == 0 && parse_duration(value, &tval) == 0 && tval > 0) {
+    sc->cross_max = tval;
+  }
+  else if (strcmp(name, "switch") == 0 && parse_duration(value, &tval) == 0 && tval >= 0) {
+    sc->switch_time = tval;
+  }
+  else if (strcmp(name, "batch_limit") == 0 && parse_long(value, &lval) == 0 && lval >= 0) {
+    sc->batch_limit = lval;
+  }
+  else if (strcmp(name, "verbose") == 0 && parse_long(value, &lval) == 0) {
+    sc->verbose = (int) lval;
+  }
+  else if (strcmp(name, "trace") == 0 && strlen(value) < sizeof(sc->trace)) {
+    strcpy(sc->trace, value);
+  }
+  else if (strcmp(name, "trace_format") == 0 && strcmp(value, "text") == 0) {
+    sc->trace_format = TRACE_TEXT;
+  }
+  else if (strcmp(name, "trace_format") == 0 && strcmp(value, "compact") == 0) {
+    sc->trace_format = TRACE_COMPACT;
+  }
+  else if (strcmp(name, "trace_sample") == 0 && parse_long(value, &lval) == 0 && lval >= 1) {
+    sc->trace_sample = lval;
+  }
+  else if (strcmp(name, "arrow") == 0 && strlen(value) < sizeof(sc->arrow)) {
+    strcpy(sc->arrow, value);
+  }
+  else if (strcmp(name, "window_report") == 0 && parse_duration(value, &tval) == 0 && tval >= 0) {
+    sc->window_report = tval;
+  }
+  else if (strcmp(name, "demand_hanover") == 0) {
+    if (parse_demand(value, sc->demand[TO_HANOVER], &sc->demand_hours[TO_HANOVER]))
+      goto invalid;
+  }
+  else if (strcmp(name, "demand_norwich") == 0) {
+    if (parse_demand(value, sc->demand[TO_NORWICH], &sc->demand_hours[TO_NORWICH]))
+      goto invalid;
+  }
+  else if (strcmp(name, "meter_hanover") == 0) {
+    if (parse_meter(value, &sc->meter_rate[TO_HANOVER], &sc->meter_burst[TO_HANOVER]))
+      goto invalid;
+  }
+  else if (strcmp(name, "meter_norwich") == 0) {
+    if (parse_meter(value, &sc->meter_rate[TO_NORWICH], &sc->meter_burst[TO_NORWICH]))
+      goto invalid;
+  }
+  else if (strcmp(name, "detour_queue") == 0 && parse_long(value, &lval) == 0 && lval >= 0) {
+    sc->detour_queue = (int) lval;
+  }
+  else if (strcmp(name, "detour_prob") == 0 && parse_double(value, &dval) == 0 &&
+	   dval >= 0 && dval <= 1) {
+    sc->detour_prob = dval;
+  }
+  else if (strcmp(name, "detour_lag") == 0 && parse_duration(value, &tval) == 0 && tval >= 0) {
+    sc->detour_lag = tval;
+  }
+  else if (strcmp(name, "balk_queue") == 0 && parse_long(value, &lval) == 0 && lval >= 0) {
+    sc->balk_queue = (int) lval;
+  }
+  else if (strcmp(name, "patience") == 0 && parse_duration(value, &tval) == 0 && tval >= 0) {
+    sc->patience = tval;
+  }
+  else if (strcmp(name, "hourly") == 0 && parse_long(value, &lval) == 0) {
+    sc->hourly = (int) lval;
+  }
+  else if (strcmp(name, "steady") == 0 && parse_long(value, &lval) == 0) {
+    sc->steady = (int) lval;
+  }
+  else if (strcmp(name, "incident") == 0) {
+    if (sc->num_incidents >= MAX_INCIDENTS) {
+      fprintf(stderr, "Error, at most %d incidents may be scheduled\n", MAX_INCIDENTS);
+      return -1;
+    }
+    if (parse_incident(value, &sc->incidents[sc->num_incidents]))
+      goto invalid;
+    sc->num_incidents++;
+  }
+  else
+    goto invalid;
+
+  return 0;
+
+ invalid:
+  fprintf(stderr, "Error, invalid setting '%s=%s'\n", key, value);
+  return -1;
+}
+
+int scenario_set_line(scenario_t* sc, const char* line) {
+  char buf[LINE_LEN];
+  char *key, *value, *end;
+
+  if (strlen(line) >= sizeof(buf))
+    return -1;
+  strcpy(buf, line);
+  for (key = buf; isspace((unsigned char) *key); key++)
+    ;
+  if (*key == '\0' || *key == '#')
+    return 0;
+  if ((value = strchr(key, '=')) == NULL)
+    return -1;
+
+  // trim both ends of the key and of the value
+  for (end = value; end > key && isspace((unsigned char) end[-1]); end--)
+    ;
+  *end = '\0';
+  for (value++; isspace((unsigned char) *value); value++)
+    ;
+  for (end = value + strlen(value); end > value && isspace((unsigned char) end[-1]); end--)
+    ;
+  *end = '\0';
+  return scenario_set(sc, key, value);
+}
+
+int scenario_read(scenario_t* sc, const char* path) {
+  char line[LINE_LEN];
+  int lineno = 0, rc = 0;
+
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening scenario file '%s'\n", path);
+    return -1;
+  }
+  while (rc == 0 && fgets(line, sizeof(line), fp) != NULL) {
+    lineno++;
+    if (scenario_set_line(sc, line)) {
+      fprintf(stderr, "Error, invalid setting on line %d of '%s'\n", lineno, path);
+      rc = -1;
+    }
+  }
+  fclose(fp);
+  return rc;
+}
+
+double scenario_peak_rate(const scenario_t* sc) {
+  double peak = 0;
+  int d, h;
+  if (sc->demand_hours[TO_HANOVER] == 0 && sc->demand_hours[TO_NORWICH] == 0)
+    return sc->rate[TO_HANOVER] + sc->rate[TO_NORWICH];
+
+  // the calendars may have different lengths; they line up again after
+  // the product of their lengths, at most a few weeks of hours
+  int hanover = sc->demand_hours[TO_HANOVER] ? sc->demand_hours[TO_HANOVER] : 1;
+  int norwich = sc->demand_hours[TO_NORWICH] ? sc->demand_hours[TO_NORWICH] : 1;
+  for (h = 0; h < hanover * norwich; h++) {
+    double total = 0;
+    for (d = 0; d < NUM_DIRECTIONS; d++)
+      total += scenario_rate(sc, d, h * SIM_HOUR);
+    if (total > peak)
+      peak = total;
+  }
+  return peak;
+}
+
+const char* scenario_problem(const scenario_t* sc) {
+  if (sc->cross_min > sc->cross_max)
+    return "cross_min must not exceed cross_max";
+  if (sc->cars == 0 && sc->horizon == 0)
+    return "either cars or horizon must limit the run";
+  if (scenario_peak_rate(sc) <= 0)
+    return "at least one direction needs a positive arrival rate";
+  return NULL;
+}
+
+int scenario_validate(const scenario_t* sc) {
+  const char* problem = scenario_problem(sc);
+  if (problem) {
+    fprintf(stderr, "Error, %s\n", problem);
+    return -1;
+  }
+  return 0;
+}
+
+void result_print(FILE* fp, const scenario_t* sc, const sim_result_t* res) {
+  uint64_t crossed = res->crossed[TO_HANOVER] + res->crossed[TO_NORWICH];
+  double hours = (double) res->end_time / SIM_HOUR;
+  double mean = crossed ? res->wait_sum / crossed : 0.0;
+  double var = crossed > 1 ? (res->wait_sumsq - crossed * mean * mean) / (crossed - 1) : 0.0;
+
+  fprintf(fp, "\n============== SIMULATION RESULTS ==============\n");
+  fprintf(fp, "Cars crossed: %llu to Hanover, %llu to Norwich\n",
+	  (unsigned long long) res->crossed[TO_HANOVER],
+	  (unsigned long long) res->crossed[TO_NORWICH]);
+  fprintf(fp, "Simulated time: %.1f minutes\n", (double) res->end_time / SIM_MIN);
+  fprintf(fp, "Throughput: %.1f cars/hour\n", hours > 0 ? crossed / hours : 0.0);
+  fprintf(fp, "Wait: mean %.1fs, std dev %.1fs, max %.1fs\n",
+	  mean, var > 0 ? sqrt(var) : 0.0, (double) res->wait_max / SIM_SEC);
+  fprintf(fp, "Queue: mean %.2f cars, max %d for Hanover, max %d for Norwich\n",
+	  res->end_time > 0 ? res->queue_area / ((double) res->end_time / SIM_SEC) : 0.0,
+	  res->max_queue[TO_HANOVER], res->max_queue[TO_NORWICH]);
+  fprintf(fp, "Direction switches: %llu\n", (unsigned long long) res->switches);
+  if (sc->meter_rate[TO_HANOVER] > 0 || sc->meter_rate[TO_NORWICH] > 0) {
+    uint64_t metered = res->metered[TO_HANOVER] + res->metered[TO_NORWICH];
+    fprintf(fp, "Ramp meters: held %llu cars, mean hold %.1fs, max %.1fs, "
+	    "most held %d for Hanover, %d for Norwich\n", (unsigned long long) metered,
+	    metered ? res->meter_delay_sum / metered : 0.0, (double) res->meter_delay_max / SIM_SEC,
+	    res->max_held[TO_HANOVER], res->max_held[TO_NORWICH]);
+  }
+
+  if (sc->detour_queue > 0)
+    fprintf(fp, "Detours: %llu to Hanover, %llu to Norwich\n",
+	    (unsigned long long) res->detoured[TO_HANOVER],
+	    (unsigned long long) res->detoured[TO_NORWICH]);
+
+  if (sc->balk_queue > 0 || sc->patience > 0) {
+    uint64_t reneged = res->reneged[TO_HANOVER] + res->reneged[TO_NORWICH];
+    fprintf(fp, "Impatient drivers: %llu balked, %llu reneged after a mean %.1fs "
+	    "(%llu/%llu for Hanover, %llu/%llu for Norwich)\n",
+	    (unsigned long long) (res->balked[TO_HANOVER] + res->balked[TO_NORWICH]),
+	    (unsigned long long) reneged, reneged ? res->renege_wait_sum / reneged : 0.0,
+	    (unsigned long long) res->balked[TO_HANOVER], (unsigned long long) res->reneged[TO_HANOVER],
+	    (unsigned long long) res->balked[TO_NORWICH], (unsigned long long) res->reneged[TO_NORWICH]);
+  }
+
+  // each car is traced with probability p, so the sample's count scales
+  // by 1/p (Horvitz-Thompson) and its mean wait estimates the mean of all
+  if (sc->trace[0] && sc->trace_sample > 1) {
+    double p = 1.0 / sc->trace_sample;
+    uint64_t n = res->traced;
+    double smean = n ? res->traced_wait_sum / n : 0.0;
+    double svar = n > 1 ? (res->traced_wait_sumsq - n * smean * smean) / (n - 1) : 0.0;
+    fprintf(fp, "Traced sample: 1 in %ld, %llu cars; estimated %.0f +/- %.0f cars, "
+	    "mean wait %.1f +/- %.1fs (95%%)\n", sc->trace_sample, (unsigned long long) n,
+	    n / p, 1.96 * sqrt(n * (1 - p)) / p, smean,
+	    n && svar > 0 ? 1.96 * sqrt((1 - p) * svar / n) : 0.0);
+  }
+
+  if (sc->steady && !res->steady_ok)
+    fprintf(fp, "Steady state: too few cars to analyse\n");
+  else if (sc->steady) {
+    const steady_stats_t* w = &res->steady_wait;
+    const steady_stats_t* q = &res->steady_queue;
+    fprintf(fp, "Steady state: first %llu of %llu cars discarded as warm-up (MSER-5)\n",
+	    (unsigned long long) w->truncated, (unsigned long long) w->count);
+    fprintf(fp, "Steady-state wait: %.2fs +/- %.2fs (95%%, %d batch means, lag-1 corr %.2f)\n",
+	    w->mean, w->half_width, w->batches, w->lag1);
+    fprintf(fp, "Steady-state queue at arrival: %.2f +/- %.2f cars (95%%, %d batch means)\n",
+	    q->mean, q->half_width, q->batches);
+    if (w->warmup_long || q->warmup_long)
+      fprintf(fp, "Warning: warm-up took half the run; the bridge may never reach steady state\n");
+  }
+
+  int i;
+  for (i = 0; i < res->num_incidents; i++) {
+    const incident_t* inc = &sc->incidents[i];
+    if (inc->type == INCIDENT_CLOSE)
+      fprintf(fp, "Incident %d (closed at %.0fs for %.0fs): ", i,
+	      (double) inc->start / SIM_SEC, (double) inc->duration / SIM_SEC);
+    else
+      fprintf(fp, "Incident %d (capacity %d at %.0fs for %.0fs): ", i, inc->capacity,
+	      (double) inc->start / SIM_SEC, (double) inc->duration / SIM_SEC);
+    if (res->recovery[i] < 0)
+      fprintf(fp, "queue never returned to baseline %.2f\n", res->baseline[i]);
+    else
+      fprintf(fp, "recovered to baseline %.2f after %.1fs\n", res->baseline[i],
+	      (double) res->recovery[i] / SIM_SEC);
+  }
+}
@@ -0,0 +1,224 @@
+/* Purpose: Shared definitions for the Ledyard Bridge simulators: the
+ * simulated clock, car directions, the scenario a run is configured with,
+ * and the metrics a run reports back.
+ *
+ * A scenario is built up from "key=value" settings so that the command
+ * line and any other front end can share the same parser.
+ */
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "steady.h" // for steady-state statistics
+
+#define MAX_CARS 3      // maximum number of cars on Ledyard at a time
+#define NO_DIRECTION -1
+#define TO_HANOVER 0
+#define TO_NORWICH 1
+#define NUM_DIRECTIONS 2
+
+#define MAX_INCIDENTS 16 // maximum scheduled incidents per scenario
+#define PATH_LEN 256     // maximum length of a file path setting
+#define MAX_DEMAND_HOURS 168 // hourly demand entries per direction (a week)
+
+/*************************** SIMULATED TIME **************************/
+
+// simulated time in microseconds; integral so runs are reproducible
+typedef int64_t sim_time_t;
+
+#define SIM_USEC 1LL
+#define SIM_SEC (1000000LL * SIM_USEC)
+#define SIM_MIN (60LL * SIM_SEC)
+#define SIM_HOUR (60LL * SIM_MIN)
+
+/*************************** DATA STRUCTURES **************************/
+
+// kinds of scheduled incidents
+#define INCIDENT_CLOSE 0    // no car may get on the bridge
+#define INCIDENT_CAPACITY 1 // the bridge holds fewer cars than usual
+
+// define a data structure for an incident injected into a running simulation
+typedef struct incident {
+  int type;            // INCIDENT_CLOSE or INCIDENT_CAPACITY
+  int capacity;        // reduced capacity while a capacity incident is active
+  sim_time_t start;    // simulated time the incident begins
+  sim_time_t duration; // how long the incident lasts
+} incident_t;
+
+// define a data structure for everything that configures one run
+typedef struct scenario {
+  uint64_t seed;        // seed for every random draw in the run
+  long cars;            // total cars to arrive (0 = limited by horizon only)
+  sim_time_t horizon;   // no arrivals after this time (0 = limited by cars only)
+  int capacity;         // maximum number of cars on the bridge at a time
+  double rate[NUM_DIRECTIONS]; // arrivals per minute towards each town
+  int demand_hours[NUM_DIRECTIONS]; // hours in each town's demand calendar
+                                    // (0 = arrivals at rate all day)
+  double demand[NUM_DIRECTIONS][MAX_DEMAND_HOURS]; // arrivals per minute in
+                        // each hour of the calendar, which then repeats
+  sim_time_t cross_min; // shortest time a car spends on the bridge
+  sim_time_t cross_max; // longest time a car spends on the bridge
+  sim_time_t switch_time; // clearance time when traffic changes direction
+  long batch_limit;     // cars one way before yielding to waiting cars the
+                        // other way (0 = never yield, like the threaded sim)
+  int verbose;          // print every arrival/boarding/exit like the threaded sim
+  char trace[PATH_LEN]; // file to record every car's events in ("" for none)
+  int trace_format;     // TRACE_TEXT or TRACE_COMPACT, see trace.h
+  long trace_sample;    // trace one car in this many, picked by a hash of
+                        // its id (1 = every car)
+  char arrow[PATH_LEN]; // file to write one row per crossed car to as an
+                        // Arrow table ("" for none), see arrow.h
+  sim_time_t window_report; // how often to print rolling metrics (0 = never)
+  int steady;           // nonzero to report warm-up truncated steady-state stats
+  int hourly;           // nonzero to print per-hour results after the run
+  double meter_rate[NUM_DIRECTIONS]; // cars per minute a ramp meter lets
+                        // through towards each town (0 = no meter)
+  int meter_burst[NUM_DIRECTIONS]; // cars a meter lets through back to back
+  int detour_queue;     // cars waiting at which drivers consider the detour
+                        // (0 = no route choice), see route.h
+  double detour_prob;   // chance such a driver takes the detour
+  sim_time_t detour_lag; // how often the discrete-event engine refreshes
+                        // the queue drivers see (0 = always current)
+  int balk_queue;       // cars queued ahead at which an arriving driver turns
+                        // back at once (0 = no one balks)
+  sim_time_t patience;  // mean time a driver waits in the lobby before giving
+                        // up, exponentially distributed (0 = waits forever)
+  int num_incidents;    // number of valid entries in incidents
+  incident_t incidents[MAX_INCIDENTS];
+} scenario_t;
+
+// define a data structure for the metrics reported by one run
+typedef struct sim_result {
+  uint64_t arrived[NUM_DIRECTIONS]; // cars that arrived towards each town
+  uint64_t crossed[NUM_DIRECTIONS]; // cars that exited towards each town
+  double wait_sum;       // sum of all waits, in seconds
+  double wait_sumsq;     // sum of all squared waits, in seconds^2
+  sim_time_t wait_max;   // longest single wait
+  int max_queue[NUM_DIRECTIONS]; // most cars ever waiting towards each town
+  uint64_t switches;     // number of times the direction of traffic flipped
+  sim_time_t end_time;   // time the last car exited
+  double queue_area;     // integral of total waiting cars over time, car-seconds
+  int num_incidents;     // number of valid entries below
+  double baseline[MAX_INCIDENTS]; // mean queue before each incident began
+  sim_time_t recovery[MAX_INCIDENTS]; // time from incident end until the queue
+                                      // fell back to baseline, -1 if never
+  int steady_ok;         // nonzero if the steady-state stats below are valid
+  steady_stats_t steady_wait;  // waits, in seconds, in boarding order
+  steady_stats_t steady_queue; // cars found waiting by each arriving car
+  uint64_t metered[NUM_DIRECTIONS]; // cars a ramp meter held back
+  double meter_delay_sum; // sum of the time they were held, in seconds
+  sim_time_t meter_delay_max; // longest time one was held
+  int max_held[NUM_DIRECTIONS]; // most cars held at each meter at once
+  uint64_t detoured[NUM_DIRECTIONS]; // cars that took the detour instead
+  uint64_t balked[NUM_DIRECTIONS];   // cars that turned back on arrival
+  uint64_t reneged[NUM_DIRECTIONS];  // cars that gave up waiting in the lobby
+  double renege_wait_sum; // sum of the time they waited first, in seconds
+  uint64_t traced;       // boarded cars in the traced sample
+  double traced_wait_sum; // sum of their waits, in seconds
+  double traced_wait_sumsq; // sum of their squared waits, in seconds^2
+} sim_result_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Fills a scenario with the defaults used when no setting overrides them
+ *
+ * @param sc the scenario to fill
+ */
+void scenario_defaults(scenario_t* sc);
+
+/* Turns off everything a scenario would print or write besides its
+ * results (verbose output, traces, Arrow tables, window reports, hourly
+ * tables) and the steady-state analysis, for modes that run it many times
+ *
+ * @param sc the scenario to edit
+ */
+void scenario_quiet(scenario_t* sc);
+
+/* Applies one "key=value" setting to a scenario. Dashes in the key are
+ * treated as underscores so command line flags read naturally.
+ *
+ * @param sc the scenario to edit
+ * @param key the setting's name
+ * @param value the setting's value as text
+ * @return 0 on success, -1 on unknown key or invalid value
+ */
+int scenario_set(scenario_t* sc, const char* key, const char* value);
+
+/* Applies one line of a scenario file: a "key=value" setting, or a blank
+ * or '#' comment line that changes nothing. Spaces around the key and
+ * value are ignored
+ *
+ * @param sc the scenario to edit
+ * @param line the line, which may end in a newline
+ * @return 0 on success, -1 on a malformed line, unknown key or invalid value
+ */
+int scenario_set_line(scenario_t* sc, const char* line);
+
+/* Applies every line of a scenario file on top of a scenario
+ *
+ * @param sc the scenario to edit
+ * @param path the file to read
+ * @return 0 on success, -1 (with a message on stderr) on any error
+ */
+int scenario_read(scenario_t* sc, const char* path);
+
+/* Finds a reason a scenario's settings cannot be simulated together
+ *
+ * @param sc the scenario to check
+ * @return the reason, or NULL if the scenario is valid
+ */
+const char* scenario_problem(const scenario_t* sc);
+
+/* Checks a scenario for settings that cannot be simulated together
+ *
+ * @param sc the scenario to check
+ * @return 0 if valid, -1 (with a message on stderr) otherwise
+ */
+int scenario_validate(const scenario_t* sc);
+
+/* Returns the arrival rate towards a town at a simulated time, from its
+ * demand calendar if it has one
+ *
+ * @param sc the scenario
+ * @param dir the town's direction
+ * @param t the simulated time
+ * @return arrivals per minute
+ */
+static inline double scenario_rate(const scenario_t* sc, int dir, sim_time_t t) {
+  int hours = sc->demand_hours[dir];
+  return hours ? sc->demand[dir][(t / SIM_HOUR) % hours] : sc->rate[dir];
+}
+
+/* Returns nonzero if either town's arrival rate follows a calendar */
+static inline int scenario_has_calendar(const scenario_t* sc) {
+  return sc->demand_hours[TO_HANOVER] || sc->demand_hours[TO_NORWICH];
+}
+
+/* Returns the highest total arrival rate at any time, in cars per minute;
+ * arrivals from a calendar are drawn at this rate and thinned
+ */
+double scenario_peak_rate(const scenario_t* sc);
+
+/* Parses a duration such as "90", "90s", "1.5m", "2h" or "250ms"
+ * (bare numbers are seconds)
+ *
+ * @param text the duration as text
+ * @param out where to save the parsed duration
+ * @return 0 on success, -1 on invalid text
+ */
+int parse_duration(const char* text, sim_time_t* out);
+
+/* Prints a human-readable summary of a run's metrics
+ *
+ * @param fp the stream to print to
+ * @param sc the scenario the run was configured with
+ * @param res the run's metrics
+ */
+void result_print(FILE* fp, const scenario_t* sc, const sim_result_t* res);
+
+/* Returns the town name for a direction, for printing */
+const char* dir_name(int dir);
+
+#endif // SCENARIO_H
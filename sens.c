@@ -0,0 +1,250 @@
+/* Purpose: Morris and Sobol sensitivity analysis of the mean wait */
+
+#include <stdio.h>
+#include <stdlib.h> // for malloc()
+#include <string.h> // for strcmp()
+#include <math.h>   // for fabs(), sqrt()
+#include "sens.h"
+#include "pool.h"
+#include "procpool.h"
+#include "rng.h"
+
+#define DESIGN_SEED 0x5e45ULL // seeds the design, not the simulations
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Builds the scenario for one design point
+ *
+ * @param base the base scenario
+ * @param opts the factor ranges
+ * @param x each factor's position in its range, from 0 to 1
+ * @param out where to save the design point's scenario
+ */
+static void apply_factors(const scenario_t* base, const sens_opts_t* opts,
+			  const double x[NUM_FACTORS], scenario_t* out) {
+  double v[NUM_FACTORS];
+  int i;
+  for (i = 0; i < NUM_FACTORS; i++)
+    v[i] = opts->factors[i].lo + x[i] * (opts->factors[i].hi - opts->factors[i].lo);
+
+  *out = *base;
+  scenario_quiet(out);
+
+  out->capacity = (int) lround(v[FACTOR_CAPACITY]);
+  if (out->capacity < 1)
+    out->capacity = 1;
+
+  sim_time_t spread = (base->cross_max - base->cross_min) / 2;
+  sim_time_t mean = (sim_time_t) (v[FACTOR_CROSS] * SIM_SEC);
+  out->cross_min = mean - spread > SIM_SEC ? mean - spread : SIM_SEC;
+  out->cross_max = mean + spread > out->cross_min ? mean + spread : out->cross_min;
+
+  double total = base->rate[TO_HANOVER] + base->rate[TO_NORWICH];
+  out->rate[TO_HANOVER] = total * v[FACTOR_SKEW];
+  out->rate[TO_NORWICH] = total * (1 - v[FACTOR_SKEW]);
+
+  out->switch_time = (sim_time_t) (v[FACTOR_SWITCH] * SIM_SEC);
+  out->batch_limit = lround(v[FACTOR_BATCH]);
+  if (out->batch_limit < 1)
+    out->batch_limit = 1;
+}
+
+/* Returns the mean wait of a run, the output every index describes */
+static double mean_wait(const sim_result_t* res) {
+  uint64_t crossed = res->crossed[TO_HANOVER] + res->crossed[TO_NORWICH];
+  return crossed ? res->wait_sum / crossed : 0.0;
+}
+
+/* Runs every design point in parallel and keeps each one's mean wait
+ *
+ * @param scs the design points
+ * @param f where to save each point's mean wait
+ * @param n the number of design points
+ * @param opts how many worker threads or processes run them
+ * @return 0 on success, -1 on allocation or simulation error
+ */
+static int evaluate(const scenario_t* scs, double* f, int n, const sens_opts_t* opts) {
+  sim_result_t* results = (sim_result_t*) malloc(n * sizeof(sim_result_t));
+  int i;
+  if (results == NULL) {
+    fprintf(stderr, "Error allocating design results\n");
+    return -1;
+  }
+  if (opts->procs ? procpool_run(scs, results, NULL, n, opts->procs, opts->timeout) :
+      pool_run(scs, results, n, opts->threads)) {
+    free(results);
+    return -1;
+  }
+  for (i = 0; i < n; i++)
+    f[i] = mean_wait(&results[i]);
+  free(results);
+  return 0;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+void sens_defaults(sens_opts_t* opts) {
+  static const sens_factor_t defaults[NUM_FACTORS] = {
+    { "capacity", 2, 5 },
+    { "cross", 20, 40 },
+    { "skew", 0.3, 0.7 },
+    { "switch", 0, 30 },
+    { "batch", 3, 30 },
+  };
+  memcpy(opts->factors, defaults, sizeof(defaults));
+  opts->samples = 20;
+  opts->threads = pool_default_threads();
+  opts->procs = 0;
+  opts->timeout = 0;
+}
+
+int sens_set_range(sens_opts_t* opts, const char* spec) {
+  char name[16];
+  double lo, hi;
+  int i;
+
+  if (sscanf(spec, "%15[^=]=%lf:%lf", name, &lo, &hi) != 3 || hi < lo)
+    return -1;
+  for (i = 0; i < NUM_FACTORS; i++) {
+    if (strcmp(name, opts->factors[i].name) == 0) {
+      opts->factors[i].lo = lo;
+      opts->factors[i].hi = hi;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int sens_morris(const scenario_t* sc, const sens_opts_t* opts,
+		double mu_star[NUM_FACTORS], double sigma[NUM_FACTORS], int* runs) {
+  const double delta = MORRIS_LEVELS / (2.0 * (MORRIS_LEVELS - 1));
+  int r = opts->samples, k = NUM_FACTORS;
+  int n = r * (k + 1);
+  int t, i, j;
+  rng_t rng;
+
+  scenario_t* scs = (scenario_t*) malloc(n * sizeof(scenario_t));
+  double* f = (double*) malloc(n * sizeof(double));
+  int* order = (int*) malloc(n * sizeof(int));  // factor moved at each step
+  double* step = (double*) malloc(n * sizeof(double)); // +delta or -delta
+  if (scs == NULL || f == NULL || order == NULL || step == NULL) {
+    fprintf(stderr, "Error allocating Morris design\n");
+    free(scs), free(f), free(order), free(step);
+    return -1;
+  }
+
+  // each trajectory starts on a random grid point and moves every factor
+  // once, in random order, by +/- delta
+  rng_seed(&rng, DESIGN_SEED);
+  for (t = 0; t < r; t++) {
+    double x[NUM_FACTORS];
+    int perm[NUM_FACTORS];
+    for (i = 0; i < k; i++) {
+      x[i] = rng_range(&rng, 0, MORRIS_LEVELS / 2 - 1) / (double) (MORRIS_LEVELS - 1);
+      perm[i] = i;
+    }
+    for (i = k - 1; i > 0; i--) {
+      j = (int) rng_range(&rng, 0, i);
+      int tmp = perm[i];
+      perm[i] = perm[j];
+      perm[j] = tmp;
+    }
+    int base = t * (k + 1);
+    for (i = 0; i < k; i++) {
+      if (rng_uniform(&rng) < 0.5)
+	x[i] += delta; // walk this factor downwards instead
+    }
+    apply_factors(sc, opts, x, &scs[base]);
+    for (i = 0; i < k; i++) {
+      int fi = perm[i];
+      double d = x[fi] + delta <= 1.0 + 1e-9 ? delta : -delta;
+      x[fi] += d;
+      order[base + i] = fi;
+      step[base + i] = d;
+      apply_factors(sc, opts, x, &scs[base + i + 1]);
+    }
+  }
+
+  int rc = evaluate(scs, f, n, opts);
+  if (rc == 0) {
+    double sum[NUM_FACTORS] = { 0 }, abs_sum[NUM_FACTORS] = { 0 }, sq[NUM_FACTORS] = { 0 };
+    for (t = 0; t < r; t++) {
+      int base = t * (k + 1);
+      for (i = 0; i < k; i++) {
+	double ee = (f[base + i + 1] - f[base + i]) / step[base + i];
+	int fi = order[base + i];
+	sum[fi] += ee;
+	abs_sum[fi] += fabs(ee);
+	sq[fi] += ee * ee;
+      }
+    }
+    for (i = 0; i < k; i++) {
+      double mean = sum[i] / r;
+      mu_star[i] = abs_sum[i] / r;
+      sigma[i] = r > 1 ? sqrt(fmax(0.0, (sq[i] - r * mean * mean) / (r - 1))) : 0.0;
+    }
+    *runs = n;
+  }
+
+  free(scs), free(f), free(order), free(step);
+  return rc;
+}
+
+int sens_sobol(const scenario_t* sc, const sens_opts_t* opts,
+	       double first[NUM_FACTORS], double total[NUM_FACTORS], int* runs) {
+  int N = opts->samples, k = NUM_FACTORS;
+  int n = N * (k + 2);
+  int j, i;
+  rng_t rng;
+
+  // layout: N rows of A, N rows of B, then N rows of AB_i for each i
+  scenario_t* scs = (scenario_t*) malloc(n * sizeof(scenario_t));
+  double* f = (double*) malloc(n * sizeof(double));
+  if (scs == NULL || f == NULL) {
+    fprintf(stderr, "Error allocating Sobol design\n");
+    free(scs), free(f);
+    return -1;
+  }
+
+  rng_seed(&rng, DESIGN_SEED);
+  for (j = 0; j < N; j++) {
+    double a[NUM_FACTORS], b[NUM_FACTORS], ab[NUM_FACTORS];
+    for (i = 0; i < k; i++) {
+      a[i] = rng_uniform(&rng);
+      b[i] = rng_uniform(&rng);
+    }
+    apply_factors(sc, opts, a, &scs[j]);
+    apply_factors(sc, opts, b, &scs[N + j]);
+    for (i = 0; i < k; i++) {
+      memcpy(ab, a, sizeof(ab));
+      ab[i] = b[i];
+      apply_factors(sc, opts, ab, &scs[(2 + i) * N + j]);
+    }
+  }
+
+  int rc = evaluate(scs, f, n, opts);
+  if (rc == 0) {
+    double mean = 0, var = 0;
+    for (j = 0; j < 2 * N; j++)
+      mean += f[j];
+    mean /= 2 * N;
+    for (j = 0; j < 2 * N; j++)
+      var += (f[j] - mean) * (f[j] - mean);
+    var /= 2 * N - 1;
+
+    for (i = 0; i < k; i++) {
+      const double* fab = &f[(2 + i) * N];
+      double s1 = 0, st = 0;
+      for (j = 0; j < N; j++) {
+	s1 += f[N + j] * (fab[j] - f[j]);        // Saltelli 2010
+	st += (f[j] - fab[j]) * (f[j] - fab[j]); // Jansen
+      }
+      first[i] = var > 0 ? s1 / N / var : 0.0;
+      total[i] = var > 0 ? st / (2.0 * N) / var : 0.0;
+    }
+    *runs = n;
+  }
+
+  free(scs), free(f);
+  return rc;
+}
@@ -0,0 +1,89 @@
+/* Purpose: Global sensitivity analysis of the mean wait to the bridge's
+ * parameters: capacity, crossing time, arrival skew, switch-over time and
+ * the batch limit policy threshold.
+ *
+ * Two designs are offered. Morris elementary effects walk one factor at a
+ * time along random trajectories and rank factors cheaply (mu* for
+ * overall influence, sigma for interactions and non-linearity). Sobol
+ * indices (Saltelli's sampling with the Jansen estimator) split the
+ * variance of the mean wait into first-order and total effects.
+ *
+ * Every design point runs on the discrete-event engine in parallel
+ * (pool.c) with the same seed, so differences between points come from
+ * the factors and not from the random arrivals (common random numbers).
+ */
+
+#ifndef SENS_H
+#define SENS_H
+
+#include "scenario.h"
+
+// the factors, in the order of sens_opts_t.factors
+#define FACTOR_CAPACITY 0
+#define FACTOR_CROSS 1  // mean crossing time, keeping the scenario's spread
+#define FACTOR_SKEW 2   // share of arrivals going to Hanover
+#define FACTOR_SWITCH 3
+#define FACTOR_BATCH 4
+#define NUM_FACTORS 5
+
+#define MORRIS_LEVELS 4 // grid levels per factor in a Morris design
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one factor's range
+typedef struct sens_factor {
+  const char* name; // the factor's name for settings and output
+  double lo;        // lowest value sampled
+  double hi;        // highest value sampled
+} sens_factor_t;
+
+// define a data structure for how to run an analysis
+typedef struct sens_opts {
+  sens_factor_t factors[NUM_FACTORS];
+  int samples;  // Morris trajectories, or Sobol base samples
+  int threads;  // worker threads running design points
+  int procs;    // worker processes running them instead (0 = use threads)
+  sim_time_t timeout; // longest real time a run may take in a worker
+                // process (0 = no limit)
+} sens_opts_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Fills analysis options with default factor ranges, 20 samples and one
+ * thread per processor
+ */
+void sens_defaults(sens_opts_t* opts);
+
+/* Changes one factor's range from a setting such as "switch=0:60"
+ *
+ * @param opts the options to edit
+ * @param spec the factor's name, '=', and its range as LO:HI
+ * @return 0 on success, -1 on unknown factor or invalid range
+ */
+int sens_set_range(sens_opts_t* opts, const char* spec);
+
+/* Computes Morris elementary effects of each factor on the mean wait
+ *
+ * @param sc the base scenario
+ * @param opts the factor ranges, trajectories and threads
+ * @param mu_star where to save each factor's mean absolute effect
+ * @param sigma where to save each factor's effect standard deviation
+ * @param runs where to save the number of simulations run
+ * @return 0 on success, -1 on allocation or simulation error
+ */
+int sens_morris(const scenario_t* sc, const sens_opts_t* opts,
+		double mu_star[NUM_FACTORS], double sigma[NUM_FACTORS], int* runs);
+
+/* Computes first-order and total Sobol indices of each factor
+ *
+ * @param sc the base scenario
+ * @param opts the factor ranges, base samples and threads
+ * @param first where to save each factor's first-order index
+ * @param total where to save each factor's total index
+ * @param runs where to save the number of simulations run
+ * @return 0 on success, -1 on allocation or simulation error
+ */
+int sens_sobol(const scenario_t* sc, const sens_opts_t* opts,
+	       double first[NUM_FACTORS], double total[NUM_FACTORS], int* runs);
+
+#endif // SENS_H
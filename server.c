@@ -0,0 +1,436 @@
+/* Purpose: A long-lived simulation server answering scenario requests
+ * from stdin or a UNIX socket on a pool of worker threads
+ */
+
+#define _DEFAULT_SOURCE // for getline(), strtok_r()
+
+#include <stdio.h>
+#include <stdlib.h>     // for malloc()
+#include <string.h>     // for strncmp()
+#include <math.h>       // for INFINITY
+#include <errno.h>      // for EINTR
+#include <signal.h>     // for signal()
+#include <pthread.h>
+#include <time.h>       // for nanosleep()
+#include <unistd.h>     // for write()
+#include <sys/socket.h> // for socket()
+#include <sys/stat.h>   // for lstat()
+#include <sys/un.h>     // for sockaddr_un
+#include "server.h"
+#include "des.h"
+
+#define MAX_QUEUED 64  // requests waiting for a worker before readers block
+#define MAX_THREADS 256
+#define MAX_BACKOFF_MS 1000 // longest pause after a failed accept()
+#define MAX_REQUEST_CARS 10000000 // most cars one request may simulate, a
+                                  // few seconds of a worker's time
+#define ERROR_LEN 128  // longest error message in an answer
+#define ANSWER_LEN 512 // longest answer line
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for a client's connection
+typedef struct conn {
+  FILE* in;             // where requests come from
+  int out;              // descriptor answers are written to
+  pthread_mutex_t lock; // keeps answers whole and guards refs
+  int refs;             // the reader plus requests not answered yet
+} conn_t;
+
+// define a data structure for one request
+typedef struct job {
+  conn_t* conn;         // where to answer
+  long id;              // echoed in the answer
+  scenario_t sc;        // the scenario to run
+  char error[ERROR_LEN]; // why the request cannot run ("" if it can)
+  struct job* next;     // next job in the queue or free list
+} job_t;
+
+// define a data structure for the queue between readers and workers
+typedef struct server {
+  const scenario_t* base; // the scenario requests start from
+  pthread_mutex_t lock;   // guards everything below
+  pthread_cond_t ready;   // a job was queued or the server is stopping
+  pthread_cond_t room;    // a worker took a job
+  job_t* head;            // oldest queued job
+  job_t* tail;            // newest queued job
+  int queued;             // jobs in the queue
+  job_t* free_jobs;       // answered jobs kept for the next requests
+  int stopping;           // nonzero once no more jobs will be queued
+} server_t;
+
+// define a data structure for a socket connection's reader thread
+typedef struct reader {
+  server_t* srv;
+  conn_t* conn;
+} reader_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Creates a connection holding one reference, for its reader
+ *
+ * @return the connection, or NULL on allocation error
+ */
+static conn_t* conn_open(FILE* in, int out) {
+  conn_t* conn = (conn_t*) malloc(sizeof(conn_t));
+  if (conn == NULL || pthread_mutex_init(&conn->lock, NULL)) {
+    fprintf(stderr, "Error allocating a server connection\n");
+    free(conn);
+    return NULL;
+  }
+  conn->in = in;
+  conn->out = out;
+  conn->refs = 1;
+  return conn;
+}
+
+/* Drops one reference to a connection, closing it with the last */
+static void conn_release(conn_t* conn) {
+  pthread_mutex_lock(&conn->lock);
+  int last = --conn->refs == 0;
+  pthread_mutex_unlock(&conn->lock);
+  if (!last)
+    return;
+  if (conn->in != stdin)
+    fclose(conn->in); // also closes out, the same socket
+  pthread_mutex_destroy(&conn->lock);
+  free(conn);
+}
+
+/* Writes one whole answer line to a connection; a client that hung up
+ * loses its answers but does not stop the server
+ */
+static void conn_answer(conn_t* conn, const char* line) {
+  size_t len = strlen(line), done = 0;
+  pthread_mutex_lock(&conn->lock);
+  while (done < len) {
+    ssize_t n = write(conn->out, line + done, len - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  pthread_mutex_unlock(&conn->lock);
+}
+
+/* Returns a job to fill, reusing an answered one when there is one
+ *
+ * @return the job, or NULL on allocation error
+ */
+static job_t* job_get(server_t* srv) {
+  pthread_mutex_lock(&srv->lock);
+  job_t* job = srv->free_jobs;
+  if (job)
+    srv->free_jobs = job->next;
+  pthread_mutex_unlock(&srv->lock);
+  if (job == NULL && (job = (job_t*) malloc(sizeof(job_t))) == NULL)
+    fprintf(stderr, "Error allocating a server request\n");
+  return job;
+}
+
+/* Keeps an answered job for reuse */
+static void job_put(server_t* srv, job_t* job) {
+  pthread_mutex_lock(&srv->lock);
+  job->next = srv->free_jobs;
+  srv->free_jobs = job;
+  pthread_mutex_unlock(&srv->lock);
+}
+
+/* Queues a job for the workers, waiting while the queue is full so a
+ * fast client cannot make the server hold unbounded work
+ */
+static void submit(server_t* srv, job_t* job) {
+  pthread_mutex_lock(&srv->lock);
+  while (srv->queued >= MAX_QUEUED)
+    pthread_cond_wait(&srv->room, &srv->lock);
+  job->next = NULL;
+  if (srv->tail)
+    srv->tail->next = job;
+  else
+    srv->head = job;
+  srv->tail = job;
+  srv->queued++;
+  pthread_cond_signal(&srv->ready);
+  pthread_mutex_unlock(&srv->lock);
+}
+
+/* Takes the oldest queued job, waiting for one
+ *
+ * @return the job, or NULL once the server is stopping and none are left
+ */
+static job_t* take(server_t* srv) {
+  pthread_mutex_lock(&srv->lock);
+  while (srv->head == NULL && !srv->stopping)
+    pthread_cond_wait(&srv->ready, &srv->lock);
+  job_t* job = srv->head;
+  if (job) {
+    if ((srv->head = job->next) == NULL)
+      srv->tail = NULL;
+    srv->queued--;
+    pthread_cond_signal(&srv->room);
+  }
+  pthread_mutex_unlock(&srv->lock);
+  return job;
+}
+
+/* Fills a job from one request line: settings applied to the base
+ * scenario, and the id to answer with
+ *
+ * @param line the request, which is modified
+ * @param lineno the request's line number, its id unless it gives one
+ */
+static void parse_request(server_t* srv, job_t* job, char* line, long lineno) {
+  char *token, *save;
+
+  job->sc = *srv->base;
+  job->id = lineno;
+  job->error[0] = '\0';
+  for (token = strtok_r(line, " \t\r\n", &save); token; token = strtok_r(NULL, " \t\r\n", &save)) {
+    if (strncmp(token, "id=", 3) == 0) {
+      if (sscanf(token + 3, "%ld", &job->id) != 1 && !job->error[0])
+	snprintf(job->error, sizeof(job->error), "invalid id '%.64s'", token + 3);
+    }
+    else if (scenario_set_line(&job->sc, token) && !job->error[0])
+      snprintf(job->error, sizeof(job->error), "invalid setting '%.64s'", token);
+  }
+  // nothing a request asks for may print or write files on the server
+  scenario_quiet(&job->sc);
+}
+
+/* Returns how many cars a scenario simulates at most: its number of cars,
+ * or the arrivals its horizon allows at the peak rate if that is fewer
+ */
+static double request_cars(const scenario_t* sc) {
+  double cars = sc->cars ? (double) sc->cars : INFINITY;
+  if (sc->horizon > 0) {
+    double by_horizon = scenario_peak_rate(sc) * ((double) sc->horizon / SIM_MIN);
+    if (by_horizon < cars)
+      cars = by_horizon;
+  }
+  return cars;
+}
+
+/* Runs a job's scenario and answers it
+ *
+ * @param bufs the worker's engine storage, or NULL to allocate per run
+ */
+static void answer(job_t* job, des_buffers_t* bufs) {
+  char line[ANSWER_LEN];
+  sim_result_t res;
+
+  const char* problem = job->error[0] ? NULL : scenario_problem(&job->sc);
+  if (problem)
+    snprintf(job->error, sizeof(job->error), "%s", problem);
+  else if (!job->error[0] && request_cars(&job->sc) > MAX_REQUEST_CARS)
+    snprintf(job->error, sizeof(job->error), "too large: at most %d cars per request",
+	     MAX_REQUEST_CARS);
+  else if (!job->error[0] &&
+	   (bufs ? des_run_warm(&job->sc, &res, bufs) : des_run(&job->sc, &res)))
+    snprintf(job->error, sizeof(job->error), "simulation failed");
+  if (job->error[0]) {
+    snprintf(line, sizeof(line), "error id=%ld %s\n", job->id, job->error);
+    conn_answer(job->conn, line);
+    return;
+  }
+
+  uint64_t crossed = res.crossed[TO_HANOVER] + res.crossed[TO_NORWICH];
+  snprintf(line, sizeof(line), "ok id=%ld crossed=%llu mean_wait=%.2f max_wait=%.1f "
+	   "mean_queue=%.2f switches=%llu minutes=%.1f\n", job->id, (unsigned long long) crossed,
+	   crossed ? res.wait_sum / crossed : 0.0, (double) res.wait_max / SIM_SEC,
+	   res.end_time > 0 ? res.queue_area / ((double) res.end_time / SIM_SEC) : 0.0,
+	   (unsigned long long) res.switches, (double) res.end_time / SIM_MIN);
+  conn_answer(job->conn, line);
+}
+
+/* Runs queued jobs until the server stops; each worker keeps its own
+ * engine storage warm across the jobs it runs
+ *
+ * @param arg the server
+ */
+static void* work(void* arg) {
+  server_t* srv = (server_t*) arg;
+  des_buffers_t bufs;
+  job_t* job;
+
+  int warm = des_buffers_init(&bufs) == 0;
+  while ((job = take(srv)) != NULL) {
+    answer(job, warm ? &bufs : NULL);
+    conn_release(job->conn);
+    job_put(srv, job);
+  }
+  if (warm)
+    des_buffers_destroy(&bufs);
+  return NULL;
+}
+
+/* Queues every request of a connection until it ends, then drops the
+ * reader's reference to it
+ */
+static void read_requests(server_t* srv, conn_t* conn) {
+  char* line = NULL;
+  size_t cap = 0;
+  long lineno = 0;
+
+  while (getline(&line, &cap, conn->in) >= 0) {
+    lineno++;
+    const char* p = line + strspn(line, " \t\r\n");
+    if (*p == '\0' || *p == '#')
+      continue;
+    job_t* job = job_get(srv);
+    if (job == NULL) {
+      char error[ERROR_LEN];
+      snprintf(error, sizeof(error), "error id=%ld out of memory\n", lineno);
+      conn_answer(conn, error);
+      continue;
+    }
+    job->conn = conn;
+    parse_request(srv, job, line, lineno);
+    pthread_mutex_lock(&conn->lock);
+    conn->refs++;
+    pthread_mutex_unlock(&conn->lock);
+    submit(srv, job);
+  }
+  free(line);
+  conn_release(conn);
+}
+
+/* Reads one socket connection's requests; runs in its own thread
+ *
+ * @param arg the reader_t, freed here
+ */
+static void* socket_reader(void* arg) {
+  reader_t r = *(reader_t*) arg;
+  free(arg);
+  read_requests(r.srv, r.conn);
+  return NULL;
+}
+
+/* Accepts connections on a UNIX socket forever, starting a reader for each.
+ * While accept() keeps failing (say, out of descriptors), it pauses for
+ * twice as long after each failure, up to MAX_BACKOFF_MS
+ *
+ * @return -1 on error setting up the socket
+ */
+static int serve_socket(server_t* srv, const char* path) {
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd, backoff_ms = 0;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error, socket path '%s' is too long\n", path);
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if (lstat(path, &st) == 0) {
+    // a socket left by an earlier server; anything else is not ours
+    if (!S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, "Error, '%s' exists and is not a socket\n", path);
+      return -1;
+    }
+    unlink(path);
+  }
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      bind(fd, (struct sockaddr*) &addr, sizeof(addr)) || listen(fd, 16)) {
+    fprintf(stderr, "Error listening on socket '%s'\n", path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  for (;;) {
+    int client = accept(fd, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR)
+	continue;
+      backoff_ms = backoff_ms ? backoff_ms * 2 : 10;
+      if (backoff_ms > MAX_BACKOFF_MS)
+	backoff_ms = MAX_BACKOFF_MS;
+      fprintf(stderr, "Error accepting a connection on '%s' (%s); retrying in %dms\n", path,
+	      strerror(errno), backoff_ms);
+      struct timespec pause = { backoff_ms / 1000, (backoff_ms % 1000) * 1000000L };
+      nanosleep(&pause, NULL);
+      continue;
+    }
+    backoff_ms = 0;
+    FILE* in = fdopen(client, "r");
+    conn_t* conn = in ? conn_open(in, client) : NULL;
+    reader_t* r = conn ? (reader_t*) malloc(sizeof(reader_t)) : NULL;
+    pthread_t thread;
+    if (r) {
+      r->srv = srv;
+      r->conn = conn;
+    }
+    if (r == NULL || pthread_create(&thread, NULL, socket_reader, r)) {
+      fprintf(stderr, "Error starting a reader for a connection on '%s'\n", path);
+      free(r);
+      if (conn)
+	conn_release(conn);
+      else if (in)
+	fclose(in);
+      else
+	close(client);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+int server_run(const scenario_t* base, const char* socket_path, int threads) {
+  pthread_t workers[MAX_THREADS];
+  server_t srv;
+  int i, started = 0, rc = 0;
+
+  if (scenario_validate(base))
+    return -1;
+  if (threads > MAX_THREADS)
+    threads = MAX_THREADS;
+  memset(&srv, 0, sizeof(srv));
+  srv.base = base;
+  if (pthread_mutex_init(&srv.lock, NULL) || pthread_cond_init(&srv.ready, NULL) ||
+      pthread_cond_init(&srv.room, NULL)) {
+    fprintf(stderr, "Error initializing the server's queue\n");
+    return -1;
+  }
+  signal(SIGPIPE, SIG_IGN); // a client hanging up must not kill the server
+
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&workers[i], NULL, work, &srv)) {
+      fprintf(stderr, "Error creating server worker %d\n", i);
+      break;
+    }
+    started++;
+  }
+  if (started == 0)
+    rc = -1;
+  else if (socket_path[0])
+    rc = serve_socket(&srv, socket_path);
+  else {
+    conn_t* conn = conn_open(stdin, STDOUT_FILENO);
+    if (conn)
+      read_requests(&srv, conn);
+    else
+      rc = -1;
+  }
+
+  // answer what is queued, then stop the workers
+  pthread_mutex_lock(&srv.lock);
+  srv.stopping = 1;
+  pthread_cond_broadcast(&srv.ready);
+  pthread_mutex_unlock(&srv.lock);
+  for (i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+  while (srv.free_jobs) {
+    job_t* job = srv.free_jobs;
+    srv.free_jobs = job->next;
+    free(job);
+  }
+  pthread_cond_destroy(&srv.room);
+  pthread_cond_destroy(&srv.ready);
+  pthread_mutex_destroy(&srv.lock);
+  return rc;
+}
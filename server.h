@@ -0,0 +1,37 @@
+/* Purpose: A long-lived simulation server for tools that ask many small
+ * what-if questions, so each one costs a simulation rather than a process
+ * start-up.
+ *
+ * A request is one line of whitespace-separated scenario settings, such
+ * as "id=7 cars=5000 rate-hanover=2.5 switch=20s", applied on top of the
+ * scenario the server was started with. "id" is echoed back (it defaults
+ * to the request's line number on its connection). Worker threads run the
+ * requests, so answers may come back out of order; each answer is one
+ * line:
+ *
+ *   ok id=7 crossed=5000 mean_wait=31.42 max_wait=310.5 mean_queue=1.52 switches=378 minutes=686.9
+ *   error id=8 invalid setting 'rate-hanover=fast'
+ *
+ * Settings that print or write files (verbose, trace, arrow, window-report,
+ * hourly) are ignored.
+ * The server reads requests from stdin and answers on stdout, or listens
+ * on a UNIX socket and serves any number of connections at once.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "scenario.h"
+
+/*************************** FUNCTIONS **************************/
+
+/* Serves requests until stdin ends, or forever on a socket
+ *
+ * @param base the scenario requests start from
+ * @param socket_path the UNIX socket to listen on, or "" for stdin/stdout
+ * @param threads the number of worker threads running simulations
+ * @return 0 on success, -1 on error setting up the server
+ */
+int server_run(const scenario_t* base, const char* socket_path, int threads);
+
+#endif // SERVER_H
@@ -0,0 +1,120 @@
+/* Purpose: A shared memory status page of the threaded bridge's live
+ * state, written under a sequence lock and read without locking
+ */
+
+#define _DEFAULT_SOURCE // for ftruncate()
+
+#include <stdio.h>
+#include <fcntl.h>    // for open()
+#include <unistd.h>   // for ftruncate()
+#include <sys/mman.h> // for mmap()
+#include <sys/stat.h> // for fstat()
+#include "statpage.h"
+#include "trace.h"
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Returns the histogram bucket of a wait */
+static int wait_bucket(sim_time_t wait) {
+  int b = 0;
+  sim_time_t limit = SIM_SEC;
+  while (wait >= limit && b < STATPAGE_BUCKETS - 1) {
+    limit *= 2;
+    b++;
+  }
+  return b;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+statpage_t* statpage_create(const char* path) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(statpage_t))) {
+    fprintf(stderr, "Error creating status page '%s'\n", path);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  statpage_t* page = mmap(NULL, sizeof(statpage_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file
+  if (page == MAP_FAILED) {
+    fprintf(stderr, "Error mapping status page '%s'\n", path);
+    return NULL;
+  }
+
+  // the file starts zeroed: no cars, nothing crossed, empty histograms
+  page->version = STATPAGE_VERSION;
+  page->size = sizeof(statpage_t);
+  page->buckets = STATPAGE_BUCKETS;
+  atomic_store_explicit(&page->dir, NO_DIRECTION, memory_order_relaxed);
+  atomic_store_explicit(&page->magic, STATPAGE_MAGIC, memory_order_release);
+  return page;
+}
+
+void statpage_update(statpage_t* page, int dir, int num_cars, const int waiting[NUM_DIRECTIONS],
+		     int type, int car_dir, sim_time_t wait, sim_time_t now) {
+  unsigned seq = atomic_load_explicit(&page->seq, memory_order_relaxed);
+  atomic_store_explicit(&page->seq, seq + 1, memory_order_relaxed);
+  // the odd sequence must be visible before any field changes
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&page->dir, dir, memory_order_relaxed);
+  atomic_store_explicit(&page->num_cars, num_cars, memory_order_relaxed);
+  atomic_store_explicit(&page->waiting[TO_HANOVER], waiting[TO_HANOVER], memory_order_relaxed);
+  atomic_store_explicit(&page->waiting[TO_NORWICH], waiting[TO_NORWICH], memory_order_relaxed);
+  if (type == TRACE_EXIT)
+    atomic_fetch_add_explicit(&page->crossed[car_dir], 1, memory_order_relaxed);
+  else if (type == TRACE_BOARD)
+    atomic_fetch_add_explicit(&page->waits[car_dir][wait_bucket(wait)], 1, memory_order_relaxed);
+  atomic_store_explicit(&page->updated, now, memory_order_relaxed);
+  atomic_store_explicit(&page->seq, seq + 2, memory_order_release);
+}
+
+const statpage_t* statpage_open(const char* path) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) || st.st_size < (off_t) sizeof(statpage_t)) {
+    fprintf(stderr, "Error opening status page '%s'\n", path);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  const statpage_t* page = mmap(NULL, sizeof(statpage_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (page == MAP_FAILED) {
+    fprintf(stderr, "Error mapping status page '%s'\n", path);
+    return NULL;
+  }
+  if (atomic_load_explicit(&page->magic, memory_order_acquire) != STATPAGE_MAGIC ||
+      page->version != STATPAGE_VERSION || page->size != sizeof(statpage_t) ||
+      page->buckets != STATPAGE_BUCKETS) {
+    fprintf(stderr, "Error, '%s' is not a version %d status page\n", path, STATPAGE_VERSION);
+    statpage_close(page);
+    return NULL;
+  }
+  return page;
+}
+
+void statpage_read(const statpage_t* page, statpage_view_t* out) {
+  unsigned before, after;
+  int d, b;
+  do {
+    before = atomic_load_explicit(&page->seq, memory_order_acquire);
+    out->dir = atomic_load_explicit(&page->dir, memory_order_relaxed);
+    out->num_cars = atomic_load_explicit(&page->num_cars, memory_order_relaxed);
+    for (d = 0; d < NUM_DIRECTIONS; d++) {
+      out->waiting[d] = atomic_load_explicit(&page->waiting[d], memory_order_relaxed);
+      out->crossed[d] = atomic_load_explicit(&page->crossed[d], memory_order_relaxed);
+      for (b = 0; b < STATPAGE_BUCKETS; b++)
+	out->waits[d][b] = atomic_load_explicit(&page->waits[d][b], memory_order_relaxed);
+    }
+    out->updated = atomic_load_explicit(&page->updated, memory_order_relaxed);
+    // the fields must be read before the sequence is checked again
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&page->seq, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  out->seq = before;
+}
+
+void statpage_close(const statpage_t* page) {
+  munmap((void*) page, sizeof(statpage_t));
+}
@@ -0,0 +1,102 @@
+/* Purpose: A status page publishing the threaded bridge's live state in a
+ * shared memory file, for dashboards and other external monitors.
+ *
+ * The bridge maps a small file and rewrites it at every event: the
+ * direction of traffic, the cars on the bridge and waiting towards each
+ * town, cumulative crossings, and a histogram of waits per direction.
+ * Monitors map the same file read-only and read it under a sequence lock,
+ * so a read costs no system call, never blocks the bridge and never
+ * touches its lock; a reader that races with an update simply retries.
+ *
+ * The page starts with a fixed header: magic, layout version and size.
+ * A monitor checks these before trusting anything else, so a new layout
+ * bumps STATPAGE_VERSION instead of being misread. Every field after the
+ * header is an atomic of fixed width, so the page is the same for any
+ * process on the machine.
+ */
+
+#ifndef STATPAGE_H
+#define STATPAGE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "scenario.h"
+
+#define STATPAGE_MAGIC 0x4c594453u // "LYDS", written last once the page is ready
+#define STATPAGE_VERSION 1
+#define STATPAGE_BUCKETS 16 // wait histogram buckets: bucket 0 counts waits
+                            // under 1s, bucket b waits in [2^(b-1), 2^b) s,
+                            // and the last one every longer wait
+#define STATPAGE_COUNTS -1  // the event type of an update that only changes
+                            // the counts, such as a driver leaving its lobby
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for the page as it lies in shared memory
+typedef struct statpage {
+  atomic_uint magic;    // STATPAGE_MAGIC once the header below is valid
+  uint32_t version;     // STATPAGE_VERSION of the layout
+  uint32_t size;        // sizeof(statpage_t)
+  uint32_t buckets;     // STATPAGE_BUCKETS
+  atomic_uint seq;      // odd while an update is under way
+  atomic_int dir;       // direction of traffic, or NO_DIRECTION
+  atomic_int num_cars;  // cars on the bridge
+  atomic_int waiting[NUM_DIRECTIONS]; // cars waiting towards each town
+  atomic_ullong crossed[NUM_DIRECTIONS]; // cars that exited towards each town
+  atomic_ullong waits[NUM_DIRECTIONS][STATPAGE_BUCKETS]; // boarded cars by wait
+  atomic_llong updated; // the bridge's clock at the last update, in usec
+} statpage_t;
+
+// define a data structure for a consistent copy of the page's state
+typedef struct statpage_view {
+  unsigned seq;         // the update the copy was taken at (even)
+  int dir;
+  int num_cars;
+  int waiting[NUM_DIRECTIONS];
+  uint64_t crossed[NUM_DIRECTIONS];
+  uint64_t waits[NUM_DIRECTIONS][STATPAGE_BUCKETS];
+  sim_time_t updated;
+} statpage_view_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Creates (or truncates) a page file and maps it for writing
+ *
+ * @param path the file to publish in, e.g. under /dev/shm
+ * @return the page, showing an idle bridge, or NULL on error
+ */
+statpage_t* statpage_create(const char* path);
+
+/* Publishes the bridge state after one car's event. Only one thread may
+ * update a page at a time; the bridge updates it holding its lock
+ *
+ * @param page the page
+ * @param dir the direction of traffic
+ * @param num_cars the cars on the bridge
+ * @param waiting the cars waiting towards each town
+ * @param type TRACE_ARRIVE, TRACE_BOARD, TRACE_EXIT or STATPAGE_COUNTS
+ * @param car_dir the car's direction
+ * @param wait how long the car waited, if it boarded
+ * @param now the bridge's clock
+ */
+void statpage_update(statpage_t* page, int dir, int num_cars, const int waiting[NUM_DIRECTIONS],
+		     int type, int car_dir, sim_time_t wait, sim_time_t now);
+
+/* Maps an existing page read-only, checking its header
+ *
+ * @param path the page's file
+ * @return the page, or NULL if it cannot be mapped or has another layout
+ */
+const statpage_t* statpage_open(const char* path);
+
+/* Copies the page's state without locking, retrying if an update raced
+ *
+ * @param page the page
+ * @param out where to save the copy
+ */
+void statpage_read(const statpage_t* page, statpage_view_t* out);
+
+/* Unmaps a page created or opened above; the file stays for monitors */
+void statpage_close(const statpage_t* page);
+
+#endif // STATPAGE_H
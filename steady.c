@@ -0,0 +1,103 @@
+/* Purpose: MSER-5 warm-up truncation and batch-means confidence intervals
+ * computed from a fixed number of stored batch means
+ */
+
+#include <stdio.h>
+#include <string.h> // for memset()
+#include <math.h>   // for sqrt()
+#include "steady.h"
+
+// 97.5% quantiles of Student's t for 1 to 30 degrees of freedom
+static const double t975[30] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+double student_t975(int df) {
+  if (df < 1)
+    df = 1;
+  if (df <= 30)
+    return t975[df - 1];
+  return 1.960 + 2.4 / df; // within 0.002 of the exact quantile above 30
+}
+
+void steady_init(steady_t* st) {
+  memset(st, 0, sizeof(*st));
+  st->batch_size = MSER_BATCH;
+}
+
+void steady_push(steady_t* st) {
+  int i;
+  st->batch[st->num_batches++] = st->partial_sum / st->partial_count;
+  st->partial_sum = 0;
+  st->partial_count = 0;
+  // merge as soon as the store fills, so every batch after it is
+  // collected at the doubled size and all batches weigh the same
+  if (st->num_batches == STEADY_BATCHES) {
+    for (i = 0; i < STEADY_BATCHES / 2; i++)
+      st->batch[i] = (st->batch[2 * i] + st->batch[2 * i + 1]) / 2;
+    st->num_batches = STEADY_BATCHES / 2;
+    st->batch_size *= 2;
+  }
+}
+
+int steady_analyze(const steady_t* st, steady_stats_t* out) {
+  int k = st->num_batches;
+  int d, best = 0, i, j;
+  double suffix_sum = 0, suffix_sq = 0, best_score = -1;
+  double sum[STEADY_BATCHES + 1], sq[STEADY_BATCHES + 1];
+
+  memset(out, 0, sizeof(*out));
+  out->count = st->count;
+  if (k < 2 * CI_BATCHES)
+    return -1;
+
+  // suffix sums let every candidate truncation point be scored in O(1)
+  sum[k] = sq[k] = 0;
+  for (i = k - 1; i >= 0; i--) {
+    suffix_sum += st->batch[i];
+    suffix_sq += st->batch[i] * st->batch[i];
+    sum[i] = suffix_sum;
+    sq[i] = suffix_sq;
+  }
+
+  // MSER: pick the truncation d minimizing the remaining batches'
+  // squared deviations over (k - d)^2; only the first half is eligible
+  for (d = 0; d <= k / 2; d++) {
+    int n = k - d;
+    double mean = sum[d] / n;
+    double score = (sq[d] - n * mean * mean) / ((double) n * n);
+    if (best_score < 0 || score < best_score) {
+      best_score = score;
+      best = d;
+    }
+  }
+  out->warmup_long = best == k / 2;
+  out->truncated = (uint64_t) best * st->batch_size;
+
+  // regroup what is left into CI_BATCHES equal batches
+  int per = (k - best) / CI_BATCHES;
+  int first = k - per * CI_BATCHES; // drop the leftover from the front
+  double means[CI_BATCHES], grand = 0, var = 0, cov = 0;
+  for (j = 0; j < CI_BATCHES; j++) {
+    double s = 0;
+    for (i = 0; i < per; i++)
+      s += st->batch[first + j * per + i];
+    means[j] = s / per;
+    grand += means[j];
+  }
+  grand /= CI_BATCHES;
+  for (j = 0; j < CI_BATCHES; j++) {
+    var += (means[j] - grand) * (means[j] - grand);
+    if (j > 0)
+      cov += (means[j] - grand) * (means[j - 1] - grand);
+  }
+
+  out->mean = grand;
+  out->batches = CI_BATCHES;
+  out->lag1 = var > 0 ? cov / var : 0.0;
+  var /= CI_BATCHES - 1;
+  out->half_width = student_t975(CI_BATCHES - 1) * sqrt(var / CI_BATCHES);
+  return 0;
+}
@@ -0,0 +1,79 @@
+/* Purpose: Steady-state statistics for long runs. Every run starts with
+ * an empty bridge, so early cars wait less than cars in the long run and
+ * a plain mean is biased low. This module removes the warm-up period with
+ * MSER-5 and reports batch-means confidence intervals for what is left.
+ *
+ * Observations are never stored individually. They are averaged into
+ * batches of 5 (as MSER-5 prescribes), and once STEADY_BATCHES batches
+ * are kept, neighbouring batches are merged pairwise and the batch size
+ * doubles. Memory is fixed and the analysis at the end costs
+ * O(STEADY_BATCHES) however many cars crossed.
+ */
+
+#ifndef STEADY_H
+#define STEADY_H
+
+#include <stdint.h>
+
+#define STEADY_BATCHES 512 // batch means kept; must be even
+#define MSER_BATCH 5       // observations per batch before any merging
+#define CI_BATCHES 20      // batches the confidence interval is built from
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one metric's observations
+typedef struct steady {
+  double batch[STEADY_BATCHES]; // means of consecutive observations
+  int num_batches;      // valid entries in batch
+  long batch_size;      // observations per entry in batch
+  double partial_sum;   // sum of observations not yet in a batch
+  long partial_count;   // observations not yet in a batch
+  uint64_t count;       // every observation seen
+} steady_t;
+
+// define a data structure for the steady-state analysis of a metric
+typedef struct steady_stats {
+  uint64_t count;     // observations seen
+  uint64_t truncated; // observations discarded as warm-up
+  double mean;        // mean after truncation
+  double half_width;  // half width of the 95% confidence interval
+  double lag1;        // lag-1 autocorrelation of the interval's batches
+  int batches;        // batches the interval was built from
+  int warmup_long;    // nonzero if warm-up took over half the run
+} steady_stats_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Initializes a metric with no observations */
+void steady_init(steady_t* st);
+
+/* Stores a full batch, merging stored batches pairwise when full;
+ * called by steady_add()
+ */
+void steady_push(steady_t* st);
+
+/* Records one observation in O(1) amortized time */
+static inline void steady_add(steady_t* st, double x) {
+  st->count++;
+  st->partial_sum += x;
+  if (++st->partial_count == st->batch_size)
+    steady_push(st);
+}
+
+/* Truncates the warm-up with MSER and computes a batch-means 95%
+ * confidence interval for the remaining observations
+ *
+ * @param st the metric's observations
+ * @param out where to save the analysis
+ * @return 0 on success, -1 if there are too few batches to analyse
+ */
+int steady_analyze(const steady_t* st, steady_stats_t* out);
+
+/* Returns the 97.5% quantile of Student's t distribution, used for
+ * two-sided 95% confidence intervals
+ *
+ * @param df degrees of freedom, at least 1
+ */
+double student_t975(int df);
+
+#endif // STEADY_H
@@ -0,0 +1,429 @@
+/* Purpose: Text and compact block-encoded per-car event traces */
+
+#define _POSIX_C_SOURCE 200809L // for fileno()
+
+#include <stdio.h>
+#include <stdlib.h> // for malloc()
+#include <string.h> // for strcmp()
+#include <fcntl.h>  // for open()
+#include <unistd.h> // for close()
+#include "trace.h"
+
+#define TEXT_LINE_LEN 128
+
+static const char* type_names[] = { "arrive", "board", "exit", "release" };
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for a shard's next event in a k-way merge
+typedef struct merge_entry {
+  trace_record_t rec; // the shard's earliest unmerged event
+  int shard;          // which shard it came from
+} merge_entry_t;
+
+// define a data structure for in-memory shards being merged
+typedef struct memory_shards {
+  trace_record_t* const* shards; // the first event of each shard
+  const size_t* lens;            // events in each shard
+  size_t* pos;                   // next event to merge from each shard
+  trace_record_t* out;           // where merged events go
+  size_t out_len;                // events merged so far
+} memory_shards_t;
+
+/********************** HELPER FUNCTIONS ********************/
+
+/* Appends an unsigned LEB128 varint, returning the bytes written */
+static size_t put_varint(unsigned char* p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (unsigned char) (v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (unsigned char) v;
+  return n;
+}
+
+/* Decodes a varint from buf[*pos..len), advancing *pos
+ *
+ * @return 0 on success, -1 if the varint is truncated or too long
+ */
+static int get_varint(const unsigned char* buf, size_t len, size_t* pos, uint64_t* out) {
+  uint64_t v = 0;
+  int shift;
+  for (shift = 0; shift < 64 && *pos < len; shift += 7) {
+    unsigned char b = buf[(*pos)++];
+    v |= (uint64_t) (b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *out = v;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* Reads a varint straight from a stream
+ *
+ * @return 1 on success, 0 at clean end of file, -1 if truncated
+ */
+static int read_varint(FILE* fp, uint64_t* out) {
+  uint64_t v = 0;
+  int shift, c;
+  for (shift = 0; shift < 64; shift += 7) {
+    if ((c = getc(fp)) == EOF)
+      return shift == 0 ? 0 : -1;
+    v |= (uint64_t) (c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *out = v;
+      return 1;
+    }
+  }
+  return -1;
+}
+
+static uint64_t zigzag(int64_t v) {
+  return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+/* Writes the pending compact block, if any, and starts a new one */
+static void flush_block(trace_writer_t* tw) {
+  unsigned char header[2 * 10];
+  size_t n;
+
+  if (tw->count == 0)
+    return;
+  n = put_varint(header, (uint64_t) tw->count);
+  n += put_varint(header + n, (uint64_t) tw->len);
+  outbuf_put(&tw->out, (const char*) header, n);
+  outbuf_put(&tw->out, (const char*) tw->block, tw->len);
+  tw->len = 0;
+  tw->count = 0;
+  tw->last_time = 0;
+  tw->last_car = 0;
+}
+
+/* Loads the next compact block of a trace being read
+ *
+ * @return 1 if a block was loaded, 0 at end of trace, -1 if corrupt
+ */
+static int load_block(trace_reader_t* tr) {
+  uint64_t count, len;
+  int rc = read_varint(tr->fp, &count);
+  if (rc <= 0)
+    return rc;
+  if (read_varint(tr->fp, &len) != 1 || len > TRACE_BLOCK_SIZE || count == 0)
+    return -1;
+  if (fread(tr->block, 1, len, tr->fp) != len)
+    return -1;
+  tr->len = len;
+  tr->pos = 0;
+  tr->remaining = (long) count;
+  tr->last_time = 0;
+  tr->last_car = 0;
+  return 1;
+}
+
+/* Parses one text trace line
+ *
+ * @return 0 on success, -1 on a malformed line
+ */
+static int parse_text(const char* line, trace_record_t* rec) {
+  long long time;
+  unsigned long long car;
+  char type[16], town[16];
+  int i;
+
+  if (sscanf(line, "%lld %15s %llu %15s", &time, type, &car, town) != 4)
+    return -1;
+  rec->time = time;
+  rec->car = car;
+  rec->seq = 0;
+  for (rec->type = -1, i = 0; i < 4; i++) {
+    if (strcmp(type, type_names[i]) == 0)
+      rec->type = i;
+  }
+  if (strcmp(town, dir_name(TO_HANOVER)) == 0)
+    rec->dir = TO_HANOVER;
+  else if (strcmp(town, dir_name(TO_NORWICH)) == 0)
+    rec->dir = TO_NORWICH;
+  else
+    return -1;
+  return rec->type < 0 ? -1 : 0;
+}
+
+/* Returns nonzero if heap entry a must be merged before entry b: the
+ * earlier event, or at equal times the one sequenced first, or the
+ * earlier shard's
+ */
+static int merge_before(const merge_entry_t* a, const merge_entry_t* b) {
+  if (a->rec.time != b->rec.time)
+    return a->rec.time < b->rec.time;
+  if (a->rec.seq != b->rec.seq)
+    return a->rec.seq < b->rec.seq;
+  return a->shard < b->shard;
+}
+
+/* Moves heap entry i down until the heap is ordered again below it */
+static void merge_sift_down(merge_entry_t* heap, int size, int i) {
+  merge_entry_t top = heap[i];
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && merge_before(&heap[child + 1], &heap[child]))
+      child++;
+    if (!merge_before(&heap[child], &top))
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = top;
+}
+
+/* Merges k time-ordered shards: repeatedly emits the earliest head event
+ * and replaces it with the next event of its shard, in O(log k) each
+ *
+ * @param next reads shard i's next event into rec: 1 if read, 0 at its
+ *        end, -1 on error
+ * @param emit saves one merged event
+ * @return the number of events merged, or -1 on error
+ */
+static long merge(int k, int (*next)(void* src, int i, trace_record_t* rec), void* src,
+		  void (*emit)(void* sink, const trace_record_t* rec), void* sink) {
+  merge_entry_t* heap = (merge_entry_t*) malloc((k > 0 ? k : 1) * sizeof(merge_entry_t));
+  long merged = 0;
+  int i, size = 0, rc;
+
+  if (heap == NULL) {
+    fprintf(stderr, "Error allocating the merge heap\n");
+    return -1;
+  }
+  for (i = 0; i < k; i++) {
+    if ((rc = next(src, i, &heap[size].rec)) < 0)
+      goto fail;
+    if (rc == 0)
+      continue;
+    heap[size].shard = i;
+    size++;
+  }
+  for (i = size / 2 - 1; i >= 0; i--)
+    merge_sift_down(heap, size, i);
+
+  while (size > 0) {
+    sim_time_t last = heap[0].rec.time;
+    emit(sink, &heap[0].rec);
+    merged++;
+    if ((rc = next(src, heap[0].shard, &heap[0].rec)) < 0)
+      goto fail;
+    if (rc == 0)
+      heap[0] = heap[--size];
+    else if (heap[0].rec.time < last) {
+      fprintf(stderr, "Error, trace shard %d is not in time order\n", heap[0].shard);
+      goto fail;
+    }
+    if (size > 0)
+      merge_sift_down(heap, size, 0);
+  }
+  free(heap);
+  return merged;
+
+ fail:
+  free(heap);
+  return -1;
+}
+
+/* Reads the next event of reader i, for merge() */
+static int next_reader(void* src, int i, trace_record_t* rec) {
+  trace_reader_t* inputs = (trace_reader_t*) src;
+  int rc = trace_read(&inputs[i], rec);
+  if (rc < 0)
+    fprintf(stderr, "Error, trace shard %d is corrupt\n", i);
+  return rc;
+}
+
+/* Writes one merged event to a trace, for merge() */
+static void emit_writer(void* sink, const trace_record_t* rec) {
+  trace_write((trace_writer_t*) sink, rec->time, rec->car, rec->type, rec->dir);
+}
+
+/* Reads the next event of in-memory shard i, for merge() */
+static int next_memory(void* src, int i, trace_record_t* rec) {
+  memory_shards_t* m = (memory_shards_t*) src;
+  if (m->pos[i] == m->lens[i])
+    return 0;
+  *rec = m->shards[i][m->pos[i]++];
+  return 1;
+}
+
+/* Appends one merged event to an array, for merge() */
+static void emit_memory(void* sink, const trace_record_t* rec) {
+  memory_shards_t* m = (memory_shards_t*) sink;
+  m->out[m->out_len++] = *rec;
+}
+
+/*********************** EXPORTED FUNCTIONS ***********************/
+
+const char* trace_type_name(int type) {
+  return type >= 0 && type < 4 ? type_names[type] : "unknown";
+}
+
+void trace_format_text(outbuf_t* ob, const trace_record_t* rec) {
+  outbuf_int(ob, rec->time);
+  outbuf_lit(ob, " ");
+  outbuf_str(ob, trace_type_name(rec->type));
+  outbuf_lit(ob, " ");
+  outbuf_int(ob, (long long) rec->car);
+  outbuf_lit(ob, " ");
+  outbuf_str(ob, dir_name(rec->dir));
+  outbuf_lit(ob, "\n");
+}
+
+int trace_open(trace_writer_t* tw, const char* path, int format) {
+  int fd = strcmp(path, "-") == 0 ? fileno(stdout) : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("Error creating trace file");
+    return -1;
+  }
+
+  memset(tw, 0, sizeof(*tw));
+  tw->format = format;
+  if (outbuf_init(&tw->out, fd, 0))
+    goto fail;
+  tw->out.line_flush = 0; // traces are data; never flush per event
+  if (format == TRACE_COMPACT) {
+    tw->block = (unsigned char*) malloc(TRACE_BLOCK_SIZE);
+    if (tw->block == NULL) {
+      fprintf(stderr, "Error allocating trace block\n");
+      outbuf_destroy(&tw->out);
+      goto fail;
+    }
+    outbuf_put(&tw->out, TRACE_MAGIC, TRACE_MAGIC_LEN);
+  }
+  return 0;
+
+ fail:
+  if (fd != fileno(stdout))
+    close(fd);
+  return -1;
+}
+
+void trace_write(trace_writer_t* tw, sim_time_t time, uint64_t car, int type, int dir) {
+  if (tw->format == TRACE_TEXT) {
+    trace_record_t rec = { time, car, type, dir, 0 };
+    trace_format_text(&tw->out, &rec);
+    return;
+  }
+
+  if (tw->len + TRACE_RECORD_MAX > TRACE_BLOCK_SIZE)
+    flush_block(tw);
+  uint64_t head = zigzag((int64_t) (car - tw->last_car)) << 3 | (uint64_t) (type << 1 | dir);
+  tw->len += put_varint(tw->block + tw->len, head);
+  tw->len += put_varint(tw->block + tw->len, zigzag(time - tw->last_time));
+  tw->last_car = car;
+  tw->last_time = time;
+  tw->count++;
+}
+
+int trace_close(trace_writer_t* tw) {
+  int fd = tw->out.fd;
+  if (tw->format == TRACE_COMPACT)
+    flush_block(tw);
+  int rc = outbuf_destroy(&tw->out);
+  free(tw->block);
+  tw->block = NULL;
+  if (fd != fileno(stdout) && close(fd)) {
+    perror("Error closing trace file");
+    rc = -1;
+  }
+  return rc;
+}
+
+int trace_reader_open(trace_reader_t* tr, const char* path) {
+  char magic[TRACE_MAGIC_LEN];
+
+  memset(tr, 0, sizeof(*tr));
+  tr->fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+  if (tr->fp == NULL) {
+    perror("Error opening trace file");
+    return -1;
+  }
+
+  // compact traces start with the magic; anything else is read as text
+  size_t n = fread(magic, 1, TRACE_MAGIC_LEN, tr->fp);
+  if (n == TRACE_MAGIC_LEN && memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0) {
+    tr->format = TRACE_COMPACT;
+    tr->block = (unsigned char*) malloc(TRACE_BLOCK_SIZE);
+    if (tr->block == NULL) {
+      fprintf(stderr, "Error allocating trace block\n");
+      trace_reader_close(tr);
+      return -1;
+    }
+  }
+  else {
+    tr->format = TRACE_TEXT;
+    if (tr->fp == stdin) {
+      // stdin cannot be rewound; push back what was read (at most 8 bytes)
+      while (n > 0)
+	ungetc(magic[--n], tr->fp);
+    }
+    else
+      rewind(tr->fp);
+  }
+  return 0;
+}
+
+int trace_read(trace_reader_t* tr, trace_record_t* rec) {
+  if (tr->format == TRACE_TEXT) {
+    char line[TEXT_LINE_LEN];
+    if (fgets(line, sizeof(line), tr->fp) == NULL)
+      return 0;
+    return parse_text(line, rec) ? -1 : 1;
+  }
+
+  if (tr->remaining == 0) {
+    int rc = load_block(tr);
+    if (rc <= 0)
+      return rc;
+  }
+  uint64_t head, dt;
+  if (get_varint(tr->block, tr->len, &tr->pos, &head) ||
+      get_varint(tr->block, tr->len, &tr->pos, &dt))
+    return -1;
+  tr->last_car += (uint64_t) unzigzag(head >> 3);
+  tr->last_time += unzigzag(dt);
+  tr->remaining--;
+
+  rec->time = tr->last_time;
+  rec->car = tr->last_car;
+  rec->type = (int) (head >> 1) & 3;
+  rec->dir = (int) head & 1;
+  rec->seq = 0;
+  return 1;
+}
+
+void trace_reader_close(trace_reader_t* tr) {
+  if (tr->fp != NULL && tr->fp != stdin)
+    fclose(tr->fp);
+  tr->fp = NULL;
+  free(tr->block);
+  tr->block = NULL;
+}
+
+long trace_merge(trace_reader_t* inputs, int k, trace_writer_t* out) {
+  return merge(k, next_reader, inputs, emit_writer, out);
+}
+
+long trace_merge_shards(trace_record_t* const* shards, const size_t* lens, int k,
+			trace_record_t* out) {
+  memory_shards_t m = { shards, lens, (size_t*) calloc(k > 0 ? k : 1, sizeof(size_t)), out, 0 };
+  if (m.pos == NULL) {
+    fprintf(stderr, "Error allocating the merge positions\n");
+    return -1;
+  }
+  long merged = merge(k, next_memory, &m, emit_memory, &m);
+  free(m.pos);
+  return merged;
+}
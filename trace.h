@@ -0,0 +1,165 @@
+/* Purpose: Per-car event traces (arrive, board, exit) written either as
+ * text, one event per line, or in a compact block encoding:
+ *
+ *   file   := "LEDTRC1\n" block*
+ *   block  := varint(records) varint(payload bytes) record*
+ *   record := varint(zigzag(car - previous car) << 3 | type << 1 | dir)
+ *             varint(zigzag(time - previous time))
+ *
+ * Deltas restart at zero in every block, so each block decodes on its
+ * own. Consecutive events mostly touch nearby cars a few seconds apart,
+ * so a record usually takes 4-5 bytes instead of a ~30 byte text line.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "scenario.h"
+#include "outbuf.h"
+#include "rng.h"
+
+// trace formats
+#define TRACE_TEXT 0
+#define TRACE_COMPACT 1
+
+// trace event types; the compact encoding has room for four
+#define TRACE_ARRIVE 0 // car joined the waiting lobby, or its ramp meter
+#define TRACE_BOARD 1  // car got on the bridge
+#define TRACE_EXIT 2   // car exited the bridge
+#define TRACE_RELEASE 3 // a metered car was let through to the lobby
+
+#define TRACE_MAGIC "LEDTRC1\n"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_BLOCK_SIZE (64 * 1024) // payload bytes per compact block
+#define TRACE_RECORD_MAX 20          // two varints of at most 10 bytes
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one traced event
+typedef struct trace_record {
+  sim_time_t time; // when the event happened
+  uint64_t car;    // the car's id
+  int type;        // TRACE_ARRIVE, TRACE_BOARD or TRACE_EXIT
+  int dir;         // the car's direction
+  uint64_t seq;    // order among events at the same time, from 1; 0 when
+                   // only the time is known, as in trace files
+} trace_record_t;
+
+// define a data structure for a trace being written
+typedef struct trace_writer {
+  outbuf_t out;          // buffered file output
+  int format;            // TRACE_TEXT or TRACE_COMPACT
+  unsigned char* block;  // compact records not yet written
+  size_t len;            // bytes used in block
+  long count;            // records in block
+  sim_time_t last_time;  // time of the previous record in block
+  uint64_t last_car;     // car of the previous record in block
+} trace_writer_t;
+
+// define a data structure for a trace being read
+typedef struct trace_reader {
+  FILE* fp;              // the trace file
+  int format;            // detected from the file's first bytes
+  unsigned char* block;  // the current compact block
+  size_t len;            // bytes in block
+  size_t pos;            // next byte to decode in block
+  long remaining;        // records left in block
+  sim_time_t last_time;  // time of the previous record in block
+  uint64_t last_car;     // car of the previous record in block
+} trace_reader_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Returns the hash limit at or under which a car is traced when one car
+ * in every n is sampled
+ *
+ * @param n the sampling interval, at least 1 (1 traces every car)
+ */
+static inline uint64_t trace_sample_limit(long n) {
+  return UINT64_MAX / (uint64_t) n;
+}
+
+/* Returns nonzero if a car is in the traced sample. The choice hashes
+ * only the car's id, so the same ids are traced in every run and by any
+ * tool that needs to know which cars a trace holds
+ *
+ * @param car the car's id
+ * @param limit from trace_sample_limit()
+ */
+static inline int trace_sampled(uint64_t car, uint64_t limit) {
+  return rng_splitmix(&car) <= limit;
+}
+
+/* Creates a trace file
+ *
+ * @param tw the writer to initialize
+ * @param path the file to create ("-" for stdout)
+ * @param format TRACE_TEXT or TRACE_COMPACT
+ * @return 0 on success, -1 on error
+ */
+int trace_open(trace_writer_t* tw, const char* path, int format);
+
+/* Appends one event to a trace */
+void trace_write(trace_writer_t* tw, sim_time_t time, uint64_t car, int type, int dir);
+
+/* Writes any buffered events and closes a trace
+ *
+ * @return 0 on success, -1 if any write failed
+ */
+int trace_close(trace_writer_t* tw);
+
+/* Opens a trace file of either format for reading
+ *
+ * @param tr the reader to initialize
+ * @param path the file to read ("-" for stdin)
+ * @return 0 on success, -1 on error
+ */
+int trace_reader_open(trace_reader_t* tr, const char* path);
+
+/* Reads the next event of a trace
+ *
+ * @param tr the reader
+ * @param rec where to save the event
+ * @return 1 if an event was read, 0 at end of trace, -1 on a corrupt trace
+ */
+int trace_read(trace_reader_t* tr, trace_record_t* rec);
+
+/* Closes a trace being read */
+void trace_reader_close(trace_reader_t* tr);
+
+/* Appends an event to a writer as a text line */
+void trace_format_text(outbuf_t* ob, const trace_record_t* rec);
+
+/* Returns the name of a trace event type */
+const char* trace_type_name(int type);
+
+/* Merges traces written in time order by separate workers into one trace
+ * in time order, streaming: memory is one block per input whatever the
+ * traces' lengths. Events at the same time go in order of their seq, and
+ * then of the inputs
+ *
+ * @param inputs the shards to merge, opened with trace_reader_open()
+ * @param k the number of shards
+ * @param out the merged trace, opened with trace_open()
+ * @return the number of events merged, or -1 if a shard is corrupt or
+ *         out of time order
+ */
+long trace_merge(trace_reader_t* inputs, int k, trace_writer_t* out);
+
+/* Merges in-memory shards of events, each in time order, into one array
+ * in time order. Events at the same time go in order of their seq, and
+ * then of the shards
+ *
+ * @param shards the first event of each shard
+ * @param lens the number of events in each shard
+ * @param k the number of shards
+ * @param out where to save the merged events; must hold all of them
+ * @return the number of events merged, or -1 if a shard is out of order
+ *         or the merge cannot allocate its heap
+ */
+long trace_merge_shards(trace_record_t* const* shards, const size_t* lens, int k,
+			trace_record_t* out);
+
+#endif // TRACE_H
@@ -0,0 +1,76 @@
+/* Purpose: Rolling 5/15/60 minute metrics kept in a ring of minute buckets */
+
+#include <stdio.h>
+#include <string.h> // for memset()
+#include "window.h"
+
+static const int window_minutes[NUM_WINDOWS] = { 5, 15, 60 };
+
+void window_init(window_t* w) {
+  memset(w, 0, sizeof(*w));
+}
+
+void window_roll(window_t* w, int64_t target) {
+  int i;
+
+  if (target - w->current >= WINDOW_BUCKETS) {
+    // idle for over an hour: every window is empty except for the queue
+    memset(w->ring, 0, sizeof(w->ring));
+    memset(w->crossed, 0, sizeof(w->crossed));
+    memset(w->boarded, 0, sizeof(w->boarded));
+    memset(w->wait_sum, 0, sizeof(w->wait_sum));
+    w->current = target;
+    w->ring[target % WINDOW_BUCKETS].max_queue = w->queued;
+    return;
+  }
+
+  while (w->current < target) {
+    w->current++;
+    // drop the bucket falling out of each window; for the longest window
+    // that is the ring slot about to be reused
+    for (i = 0; i < NUM_WINDOWS; i++) {
+      int64_t leaving = w->current - window_minutes[i];
+      if (leaving < 0)
+	continue;
+      window_bucket_t* old = &w->ring[leaving % WINDOW_BUCKETS];
+      w->crossed[i] -= old->crossed;
+      w->boarded[i] -= old->boarded;
+      w->wait_sum[i] -= old->wait_sum;
+    }
+    window_bucket_t* fresh = &w->ring[w->current % WINDOW_BUCKETS];
+    memset(fresh, 0, sizeof(*fresh));
+    fresh->max_queue = w->queued; // cars still waiting count in the new minute
+  }
+}
+
+void window_get(window_t* w, sim_time_t now, int i, window_stats_t* out) {
+  int64_t first, b;
+
+  window_advance(w, now);
+  first = w->current - window_minutes[i] + 1;
+  if (first < 0)
+    first = 0;
+
+  sim_time_t span = now - first * WINDOW_BUCKET;
+  out->minutes = window_minutes[i];
+  out->throughput = span > 0 ? (double) w->crossed[i] * SIM_HOUR / span : 0.0;
+  out->mean_wait = w->boarded[i] ? w->wait_sum[i] / w->boarded[i] : 0.0;
+  out->max_queue = 0;
+  for (b = first; b <= w->current; b++) {
+    if (w->ring[b % WINDOW_BUCKETS].max_queue > out->max_queue)
+      out->max_queue = w->ring[b % WINDOW_BUCKETS].max_queue;
+  }
+}
+
+void window_print(FILE* fp, window_t* w, sim_time_t now) {
+  window_stats_t st;
+  int i;
+
+  fprintf(fp, "[%7.1fm]", (double) now / SIM_MIN);
+  for (i = 0; i < NUM_WINDOWS; i++) {
+    window_get(w, now, i, &st);
+    fprintf(fp, "%s last %dm: %.0f cars/h, wait %.1fs, max queue %d",
+	    i ? " |" : "", st.minutes, st.throughput, st.mean_wait, st.max_queue);
+  }
+  fprintf(fp, "\n");
+}
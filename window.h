@@ -0,0 +1,111 @@
+/* Purpose: Rolling metrics over the last 5, 15 and 60 simulated minutes
+ * (throughput, mean wait, longest queue), maintained as cars board and
+ * exit instead of being recomputed from a trace after the run.
+ *
+ * Time is cut into one-minute buckets kept in a ring of the last hour.
+ * Each window keeps running sums that gain the newest bucket and lose the
+ * bucket that falls out of it, so every update is O(1) and memory is
+ * fixed no matter how long the run is.
+ */
+
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "scenario.h"
+
+#define WINDOW_BUCKET SIM_MIN // length of one bucket
+#define WINDOW_BUCKETS 60     // buckets kept; the longest window
+#define NUM_WINDOWS 3         // windows of 5, 15 and 60 buckets
+
+/*************************** DATA STRUCTURES **************************/
+
+// define a data structure for one minute of metrics
+typedef struct window_bucket {
+  uint64_t crossed; // cars that exited during the minute
+  uint64_t boarded; // cars that got on the bridge during the minute
+  double wait_sum;  // sum of those cars' waits, in seconds
+  int max_queue;    // most cars waiting at once during the minute
+} window_bucket_t;
+
+// define a data structure for the rolling metrics of one run
+typedef struct window {
+  window_bucket_t ring[WINDOW_BUCKETS]; // bucket b lives at ring[b % WINDOW_BUCKETS]
+  int64_t current;  // index of the newest bucket, time / WINDOW_BUCKET
+  int queued;       // cars waiting right now
+  uint64_t crossed[NUM_WINDOWS]; // running sums over each window
+  uint64_t boarded[NUM_WINDOWS];
+  double wait_sum[NUM_WINDOWS];
+} window_t;
+
+// define a data structure for one window's metrics at a point in time
+typedef struct window_stats {
+  int minutes;       // the window's length
+  double throughput; // cars exiting per hour
+  double mean_wait;  // mean wait of cars that boarded, in seconds
+  int max_queue;     // most cars waiting at once
+} window_stats_t;
+
+/*************************** FUNCTIONS **************************/
+
+/* Initializes empty rolling metrics starting at time 0 */
+void window_init(window_t* w);
+
+/* Moves the newest bucket forward to bucket target, dropping buckets
+ * that fall out of the windows; see window_advance()
+ */
+void window_roll(window_t* w, int64_t target);
+
+/* Moves the newest bucket forward to the one holding now; called by the
+ * updates below, and cheap when now is still in the newest bucket
+ */
+static inline void window_advance(window_t* w, sim_time_t now) {
+  int64_t target = now / WINDOW_BUCKET;
+  if (target > w->current)
+    window_roll(w, target);
+}
+
+/* Records a car getting on the bridge after waiting for wait */
+static inline void window_board(window_t* w, sim_time_t now, sim_time_t wait) {
+  int i;
+  double wait_sec = (double) wait / SIM_SEC;
+  window_advance(w, now);
+  w->ring[w->current % WINDOW_BUCKETS].boarded++;
+  w->ring[w->current % WINDOW_BUCKETS].wait_sum += wait_sec;
+  for (i = 0; i < NUM_WINDOWS; i++) {
+    w->boarded[i]++;
+    w->wait_sum[i] += wait_sec;
+  }
+}
+
+/* Records a car exiting the bridge */
+static inline void window_exit(window_t* w, sim_time_t now) {
+  int i;
+  window_advance(w, now);
+  w->ring[w->current % WINDOW_BUCKETS].crossed++;
+  for (i = 0; i < NUM_WINDOWS; i++)
+    w->crossed[i]++;
+}
+
+/* Records the number of cars now waiting */
+static inline void window_queue(window_t* w, sim_time_t now, int queued) {
+  window_advance(w, now);
+  w->queued = queued;
+  if (queued > w->ring[w->current % WINDOW_BUCKETS].max_queue)
+    w->ring[w->current % WINDOW_BUCKETS].max_queue = queued;
+}
+
+/* Computes one window's metrics as of now
+ *
+ * @param w the rolling metrics
+ * @param now the current simulated time
+ * @param i which window, 0 to NUM_WINDOWS - 1
+ * @param out where to save the metrics
+ */
+void window_get(window_t* w, sim_time_t now, int i, window_stats_t* out);
+
+/* Prints every window's metrics as of now on one line */
+void window_print(FILE* fp, window_t* w, sim_time_t now);
+
+#endif // WINDOW_H